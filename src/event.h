@@ -36,6 +36,11 @@ enum class Action {
     MODE_REMOVE,
     MODE_PAINT,
     TOGGLE_WIREFRAME,
+    TOGGLE_OCCLUSION_CULLING,
+    TOGGLE_SSAO,
+    TOGGLE_RADIOSITY,
+    TOGGLE_INSTANCED_BLOCKS,
+    TOGGLE_CPU_PICKING,
     BLOCK_CUBE,
     BLOCK_SLOPE,
     BLOCK_RSLOPE,
@@ -45,10 +50,35 @@ enum class Action {
     BLOCK_INVCORNER,
     BLOCK_RINVCORNER,
     ROTATE_BLOCK,
+    SELECT_BLOCKS,
+    CLEAR_SELECTION,
+    DELETE_SELECTION,
+    RETYPE_SELECTION,
+    ROTATE_SELECTION,
     TEXT_INPUT,
     EXPORT_TILE
 };
 
+// How an event is merged into an equal one still waiting to be delegated,
+// see EventManager::addEvent
+enum class Coalescing {
+    NONE,
+    DUPLICATES, // Dropped if its arguments equal the waiting event's
+    LATEST // The waiting event takes the last argument of the new one, if 
+           // the others are equal (e.g. the cursor position of MODIFY)
+};
+
+inline Coalescing getCoalescing(Action action) {
+    switch (action) {
+    case Action::REBUILD_TILE:
+        return Coalescing::DUPLICATES;
+    case Action::MODIFY:
+        return Coalescing::LATEST;
+    default:
+        return Coalescing::NONE;
+    }
+}
+
 struct EventInterface {
     std::vector<std::string> ids;
     Action action;
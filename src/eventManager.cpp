@@ -23,7 +23,10 @@ SOFTWARE.
 ==============================================================================*/
 #include "eventManager.h"
 
+#include <iostream>
+
 void EventManager::addEvent(std::shared_ptr<EventInterface> sptr) {
+    eventsRaised++;
     events.push_back(sptr);
 }
 
@@ -45,8 +48,15 @@ void EventManager::delegateEvents() {
             auto iterator = listeners.find(id);
             if (iterator != listeners.end()) {
                 iterator->second->events.push_back(event);
+                eventsDelivered++;
             }
         }
     }
     events.clear();
+}
+
+void EventManager::printStats() {
+    std::cout << "Events raised: " << eventsRaised << ", coalesced: " 
+              << eventsCoalesced << ", delivered: " << eventsDelivered 
+              << std::endl;
 }
\ No newline at end of file
@@ -29,8 +29,25 @@ SOFTWARE.
 
 #include "event.h"
 
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
+// Whether two Arg_Types can be compared with ==, since only events with 
+// comparable arguments can be coalesced
+template <typename Arg_Type>
+class IsEqualityComparable {
+    template <typename T>
+    static auto test(const T* value) 
+        -> decltype(*value == *value, std::true_type());
+
+    template <typename T>
+    static std::false_type test(...);
+
+public:
+    static const bool value = decltype(test<Arg_Type>(nullptr))::value;
+};
+
 class Listener {
 public:
     std::vector<std::shared_ptr<EventInterface>> events;
@@ -41,12 +58,26 @@ public:
     std::vector<std::shared_ptr<EventInterface>> events;
     boost::unordered_map<std::string, Listener*> listeners;
 
+    unsigned long long eventsRaised = 0;
+    unsigned long long eventsCoalesced = 0; // Merged into a waiting event
+    unsigned long long eventsDelivered = 0; // Counted once per listener
+
     void addEvent(std::shared_ptr<EventInterface> sptr);
     void addListener(std::string id, Listener* listener);
     void removeListener(std::string id);
 
+    // Events repeated before being delegated are merged according to their
+    // action's Coalescing, e.g. each cursor move of a stroke may raise the 
+    // same MODIFY and REBUILD_TILE events
     template <typename Arg_Type>
     void addEvent(std::vector<std::string> ids, Action action, std::vector<Arg_Type> args) {
+        eventsRaised++;
+        if (getCoalescing(action) != Coalescing::NONE 
+         && coalesce(ids, action, args, std::integral_constant<bool, 
+                     IsEqualityComparable<Arg_Type>::value>())) {
+            eventsCoalesced++;
+            return;
+        }
         std::shared_ptr<Event<Arg_Type>> event(new Event<Arg_Type>());
         for (auto arg : args) {
             event->args.push_back(arg);
@@ -59,6 +90,51 @@ public:
     }
 
     void delegateEvents();
+
+    void printStats();
+
+private:
+    // Arguments without == are never coalesced
+    template <typename Arg_Type>
+    bool coalesce(const std::vector<std::string>&, Action, 
+                  const std::vector<Arg_Type>&, std::false_type) {
+        return false;
+    }
+
+    template <typename Arg_Type>
+    bool coalesce(const std::vector<std::string>& ids, Action action, 
+                  const std::vector<Arg_Type>& args, std::true_type) {
+        Coalescing coalescing = getCoalescing(action);
+        // Only the latest event for the same listeners is considered, so 
+        // that the order each listener sees is kept
+        for (auto it = events.rbegin(); it != events.rend(); it++) {
+            bool shared = false;
+            for (auto& id : ids) {
+                if (std::find((*it)->ids.begin(), (*it)->ids.end(), id) 
+                    != (*it)->ids.end()) {
+                    shared = true;
+                }
+            }
+            if (!shared) {
+                continue;
+            }
+            auto event = std::dynamic_pointer_cast<Event<Arg_Type>>(*it);
+            if ((*it)->ids != ids || (*it)->action != action || !event
+             || event->args.size() != args.size()) {
+                return false;
+            }
+            if (coalescing == Coalescing::DUPLICATES) {
+                return event->args == args;
+            }
+            if (args.empty() || !std::equal(args.begin(), args.end() - 1, 
+                                            event->args.begin())) {
+                return false;
+            }
+            event->args.back() = args.back();
+            return true;
+        }
+        return false;
+    }
 };
 
 #endif 
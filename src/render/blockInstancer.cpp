@@ -0,0 +1,306 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "blockInstancer.h"
+#include "tileMesh.h"
+
+#include <algorithm>
+#include <iostream>
+
+BlockInstancer::BlockInstancer(const TileMesher* tileMesher) 
+                                : tileMesher(tileMesher) {
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &shapeBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    buildShapes();
+}
+
+BlockInstancer::~BlockInstancer() {
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &shapeBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+}
+
+void BlockInstancer::buildShapes() {
+    std::vector<ShapeVertex> vertices;
+    for (auto& shapePair : tileMesher->getShapes()) {
+        for (const Mesh* mesh : shapePair.second) {
+            Shape shape;
+            shape.firstVertex = vertices.size();
+            int numTriangles = 0;
+
+            for (const Mesh::Face& face : mesh->faces) {
+                // Variants share some of their triangles, which are then 
+                // stored once
+                typedef struct FaceTriangle {
+                    unsigned short vertices[3];
+                    int bit;
+                } FaceTriangle;
+                std::vector<FaceTriangle> faceTriangles;
+                std::vector<uint32_t> masks(Mesh::NUM_VARIANTS, 0);
+
+                for (int variant = 0; variant < Mesh::NUM_VARIANTS; variant++) {
+                    for (int t = 0; t < face.numTriangles[variant]; t++) {
+                        const unsigned short* triangle = 
+                            face.triangles[variant][t];
+                        auto it = std::find_if(faceTriangles.begin(), 
+                                               faceTriangles.end(),
+                            [&](const FaceTriangle& other) {
+                                return std::equal(triangle, triangle + 3, 
+                                                  other.vertices);
+                            });
+                        if (it == faceTriangles.end()) {
+                            FaceTriangle faceTriangle;
+                            std::copy(triangle, triangle + 3, 
+                                      faceTriangle.vertices);
+                            faceTriangle.bit = std::min(numTriangles++, 
+                                                        MAX_TRIANGLES);
+                            faceTriangles.push_back(faceTriangle);
+                            it = faceTriangles.end() - 1;
+
+                            glm::vec3 normal = mesh->normals[triangle[0]];
+                            for (int v = 0; v < 3; v++) {
+                                glm::vec3 position = 
+                                    mesh->vertices[triangle[v]];
+                                ShapeVertex vertex;
+                                vertex.position[0] = position.x;
+                                vertex.position[1] = position.y;
+                                vertex.position[2] = position.z;
+                                vertex.normal = TileMesh::getBucket(normal);
+                                // Block 0 encodes as 1 + the face
+                                vertex.face = 
+                                    TileMesh::getColourID(normal, 0) - 1;
+                                vertex.triangle = faceTriangle.bit;
+                                vertex.padding = 0;
+                                vertices.push_back(vertex);
+                            }
+                        }
+                        if (it->bit < MAX_TRIANGLES) {
+                            masks[variant] |= 1u << it->bit;
+                        }
+                    }
+                }
+                shape.faceMasks.push_back(masks);
+            }
+            if (numTriangles > MAX_TRIANGLES) {
+                std::cout << "Shape has " << numTriangles << " triangles, "
+                          << "those past " << MAX_TRIANGLES 
+                          << " are always drawn when instancing" << std::endl;
+            }
+
+            shape.numVertices = vertices.size() - shape.firstVertex;
+            shapeIndices[mesh] = shapes.size();
+            shapes.push_back(shape);
+        }
+    }
+    frameInstances.resize(shapes.size());
+
+    shapeBufferSize = sizeof(ShapeVertex) * vertices.size();
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, shapeBuffer);
+    glBufferData(GL_ARRAY_BUFFER, shapeBufferSize, vertices.data(), 
+                 GL_STATIC_DRAW);
+
+    GLsizei stride = sizeof(ShapeVertex);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 
+                          (void*)offsetof(ShapeVertex, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, stride, 
+                           (void*)offsetof(ShapeVertex, normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, stride, 
+                           (void*)offsetof(ShapeVertex, face));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_BYTE, stride, 
+                           (void*)offsetof(ShapeVertex, triangle));
+
+    // The instance attributes point into the instance buffer, at an offset
+    // set per draw
+    for (GLuint attribute = 4; attribute <= 7; attribute++) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BlockInstancer::buildInstances(Scene* scene, Scene::Tile* tile,
+                                    TileInstances& tileInstances) {
+    Scene::TileSnapshot snapshot = scene->getTileSnapshot(tile);
+    glm::ivec3 dimensions = snapshot.dimensions;
+
+    std::vector<std::vector<BlockInstance>> shapeInstances(shapes.size());
+    for (int i = 0; i < dimensions.x * dimensions.y * dimensions.z; i++) {
+        glm::ivec3 location(i % dimensions.x, (i / dimensions.x) % dimensions.y,
+                            i / (dimensions.x * dimensions.y));
+
+        const Mesh* mesh = tileMesher->getShape(snapshot.getBlock(location));
+        if (mesh == nullptr) {
+            continue;
+        }
+        int shapeIndex = shapeIndices.at(mesh);
+        const Shape& shape = shapes[shapeIndex];
+
+        uint32_t triangleMask = 0;
+        for (size_t f = 0; f < mesh->faces.size(); f++) {
+            Mesh::FaceVariant variant = 
+                tileMesher->getFaceVariant(snapshot, location, mesh->faces[f]);
+            triangleMask |= shape.faceMasks[f][variant];
+        }
+        // Blocks covered on every side are left out, unless their shape has
+        // triangles that cannot be masked
+        bool unmasked = shape.numVertices > 3 * MAX_TRIANGLES;
+        if (triangleMask == 0 && !unmasked) {
+            continue;
+        }
+
+        glm::ivec3 position = tile->location * dimensions + location;
+        BlockInstance instance;
+        instance.position[0] = position.x;
+        instance.position[1] = position.y;
+        instance.position[2] = position.z;
+        instance.block = i;
+        instance.colourBase = TileMesh::getColourID(glm::vec3(0.0f), i) 
+                            | tileInstances.colourBits;
+        instance.triangleMask = triangleMask;
+        shapeInstances[shapeIndex].push_back(instance);
+    }
+
+    tileInstances.instances.clear();
+    tileInstances.shapeStart.clear();
+    for (auto& instances : shapeInstances) {
+        tileInstances.shapeStart.push_back(tileInstances.instances.size());
+        tileInstances.instances.insert(tileInstances.instances.end(),
+                                       instances.begin(), instances.end());
+    }
+    tileInstances.shapeStart.push_back(tileInstances.instances.size());
+    tileInstances.instances.shrink_to_fit();
+}
+
+void BlockInstancer::addTile(Scene* scene, Scene::Tile* tile, 
+                             unsigned int tileColourBits) {
+    if (tile->handle >= tiles.size()) {
+        tiles.resize(tile->handle + 1);
+    }
+    TileInstances& tileInstances = tiles[tile->handle];
+    if (tileInstances.shapeStart.empty() 
+     || tileInstances.location != tile->location
+     || tileInstances.revision != tile->revision
+     || tileInstances.colourBits != tileColourBits) {
+        tileInstances.location = tile->location;
+        tileInstances.revision = tile->revision;
+        tileInstances.colourBits = tileColourBits;
+        buildInstances(scene, tile, tileInstances);
+    }
+
+    for (size_t i = 0; i < shapes.size(); i++) {
+        frameInstances[i].insert(frameInstances[i].end(),
+            tileInstances.instances.begin() + tileInstances.shapeStart[i],
+            tileInstances.instances.begin() + tileInstances.shapeStart[i + 1]);
+    }
+}
+
+void BlockInstancer::invalidate(glm::ivec3 tileLocation) {
+    for (auto& tileInstances : tiles) {
+        if (tileInstances.location == tileLocation) {
+            tileInstances.shapeStart.clear();
+        }
+    }
+}
+
+void BlockInstancer::removeTile(glm::ivec3 tileLocation) {
+    for (auto& tileInstances : tiles) {
+        if (tileInstances.location == tileLocation) {
+            tileInstances = TileInstances();
+        }
+    }
+}
+
+unsigned int BlockInstancer::draw() {
+    numInstances = 0;
+    for (auto& instances : frameInstances) {
+        numInstances += instances.size();
+    }
+    if (numInstances == 0) {
+        return 0;
+    }
+
+    // Orphaned every frame, and grown as needed
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    size_t size = sizeof(BlockInstance) * numInstances;
+    if (size > instanceBufferSize) {
+        instanceBufferSize = std::max(size, instanceBufferSize * 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, instanceBufferSize, nullptr, GL_STREAM_DRAW);
+
+    glBindVertexArray(vertexArray);
+    unsigned int drawCalls = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < shapes.size(); i++) {
+        std::vector<BlockInstance>& instances = frameInstances[i];
+        if (instances.empty()) {
+            continue;
+        }
+        size_t bytes = sizeof(BlockInstance) * instances.size();
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, instances.data());
+
+        GLsizei stride = sizeof(BlockInstance);
+        glVertexAttribIPointer(4, 3, GL_SHORT, stride, 
+            (void*)(offset + offsetof(BlockInstance, position)));
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_SHORT, stride, 
+            (void*)(offset + offsetof(BlockInstance, block)));
+        glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, stride, 
+            (void*)(offset + offsetof(BlockInstance, colourBase)));
+        glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, stride, 
+            (void*)(offset + offsetof(BlockInstance, triangleMask)));
+
+        glDrawArraysInstanced(GL_TRIANGLES, shapes[i].firstVertex, 
+                              shapes[i].numVertices, instances.size());
+        drawCalls++;
+
+        offset += bytes;
+        instances.clear();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return drawCalls;
+}
+
+size_t BlockInstancer::getGPUBytes() {
+    return shapeBufferSize + instanceBufferSize;
+}
+
+size_t BlockInstancer::getCPUBytes() {
+    size_t bytes = 0;
+    for (auto& tileInstances : tiles) {
+        bytes += sizeof(BlockInstance) * tileInstances.instances.capacity()
+               + sizeof(unsigned int) * tileInstances.shapeStart.capacity();
+    }
+    return bytes;
+}
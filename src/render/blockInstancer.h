@@ -0,0 +1,144 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef BLOCKINSTANCER_H
+#define BLOCKINSTANCER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "mesh.h"
+#include "tileMesher.h"
+#include "../scene.h"
+
+/**
+  * Draws tiles as instances of their blocks' shapes, as opposed to baked 
+  * tile meshes. Every shape and rotation is uploaded once, with each of its
+  * faces split into every triangle any visibility variant uses. A block is
+  * then a 16 byte instance, with a mask of the triangles left visible by its
+  * neighbours; the vertex shader collapses the rest.
+  */
+class BlockInstancer {
+public:
+    typedef struct BlockInstance {
+        int16_t position[3];  /*< Block coordinates within the scene */
+        uint16_t block;       /*< Index of the block within its tile */
+        uint32_t colourBase;  /*< Picking ID of the block, less the face */
+        uint32_t triangleMask; /*< Bit i set when shape triangle i is drawn */
+    } BlockInstance;
+
+    static const int MAX_TRIANGLES = 32; /*< Per shape, as fit in the mask */
+
+/**
+  * @param tileMesher Provides the shapes and the face visibility rules. Must
+  *                   outlive the instancer.
+  */
+    BlockInstancer(const TileMesher* tileMesher);
+
+    ~BlockInstancer();
+
+/**
+  * Adds the tile's blocks to the ones drawn by the next call to draw. The
+  * tile's instances are rebuilt if it has changed since they were built.
+  *
+  * @param tileColourBits Tile ID shifted past the block bits, for picking
+  */
+    void addTile(Scene* scene, Scene::Tile* tile, unsigned int tileColourBits);
+
+/**
+  * Rebuilds the tile's instances when it is next added. Edits to blocks 
+  * bordering the tile change which of its faces are hidden, without 
+  * changing its revision.
+  */
+    void invalidate(glm::ivec3 tileLocation);
+
+/**
+  * Forgets the instances of tiles no longer in the scene.
+  */
+    void removeTile(glm::ivec3 tileLocation);
+
+/**
+  * Draws every block added since the last call, one call per shape and
+  * rotation, with the entity shader's outputs.
+  *
+  * @return Number of draw calls made
+  */
+    unsigned int draw();
+
+    unsigned int getNumInstances() { return numInstances; }
+
+    size_t getGPUBytes(); /*< Shape vertices and the instance buffer */
+
+    size_t getCPUBytes(); /*< Instances kept per tile */
+
+private:
+    typedef struct ShapeVertex {
+        float position[3];    /*< Relative to the block centre */
+        uint8_t normal;       /*< Bucket, see TileMesh::getBucket */
+        uint8_t face;         /*< Added to the block's picking ID */
+        uint8_t triangle;     /*< Bit of the instance mask, or MAX_TRIANGLES
+                                  for triangles always drawn */
+        uint8_t padding;
+    } ShapeVertex;
+
+    typedef struct Shape {
+        GLint firstVertex;
+        GLsizei numVertices;
+        std::vector<std::vector<uint32_t>> faceMasks; /*< Per face, variant */
+    } Shape;
+
+    typedef struct TileInstances {
+        glm::ivec3 location;
+        unsigned int revision = 0;
+        unsigned int colourBits = 0;
+        std::vector<BlockInstance> instances; /*< Sorted by shape */
+        std::vector<unsigned int> shapeStart; /*< Per shape, and one past */
+    } TileInstances;
+
+    const TileMesher* tileMesher;
+
+    std::vector<Shape> shapes; /*< One per shape and rotation */
+    std::map<const Mesh*, int> shapeIndices;
+
+    std::vector<TileInstances> tiles; /*< Indexed by tile handle */
+
+    std::vector<std::vector<BlockInstance>> frameInstances; /*< Per shape */
+    unsigned int numInstances = 0; /*< Drawn by the last draw */
+
+    GLuint vertexArray;
+    GLuint shapeBuffer;
+    GLuint instanceBuffer;
+    size_t shapeBufferSize = 0;
+    size_t instanceBufferSize = 0;
+
+    void buildShapes();
+
+    void buildInstances(Scene* scene, Scene::Tile* tile, 
+                        TileInstances& tileInstances);
+};
+
+#endif
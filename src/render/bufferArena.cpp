@@ -0,0 +1,171 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "bufferArena.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+BufferArena::BufferArena(size_t pageSize, size_t alignment) 
+                            : pageSize(pageSize), alignment(alignment) {
+}
+
+BufferArena::~BufferArena() {
+    if (numAllocations > 0) {
+        std::cout << "Buffer arena destroyed with " << numAllocations 
+                  << " live allocations (" << liveBytes << " bytes)" 
+                  << std::endl;
+    }
+    for (auto& page : pages) {
+        glDeleteBuffers(1, &page.buffer);
+    }
+}
+
+int BufferArena::addPage(size_t size) {
+    Page page;
+    page.size = size;
+    page.freeBlocks[0] = size;
+
+    // Uploads go through the copy binding, leaving vertex array state alone
+    glGenBuffers(1, &page.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    pages.push_back(page);
+    return pages.size() - 1;
+}
+
+BufferArena::Allocation BufferArena::allocate(size_t size) {
+    size = (size + alignment - 1) / alignment * alignment;
+
+    Allocation allocation;
+    // First fit; tile meshes are similar enough in size for it to do well
+    for (size_t i = 0; i < pages.size() && allocation.page == -1; i++) {
+        for (auto& freeBlock : pages[i].freeBlocks) {
+            if (freeBlock.second >= size) {
+                allocation.page = i;
+                allocation.offset = freeBlock.first;
+                break;
+            }
+        }
+    }
+    if (allocation.page == -1) {
+        size_t newPageSize = (std::max(size, pageSize) + alignment - 1) 
+                           / alignment * alignment;
+        allocation.page = addPage(newPageSize);
+        allocation.offset = 0;
+    }
+    allocation.size = size;
+
+    auto& freeBlocks = pages[allocation.page].freeBlocks;
+    auto freeIt = freeBlocks.find(allocation.offset);
+    size_t remaining = freeIt->second - size;
+    freeBlocks.erase(freeIt);
+    if (remaining > 0) {
+        freeBlocks[allocation.offset + size] = remaining;
+    }
+
+    liveBytes += size;
+    numAllocations++;
+    return allocation;
+}
+
+void BufferArena::free(Allocation& allocation) {
+    if (allocation.page == -1) {
+        return;
+    }
+
+    auto& freeBlocks = pages[allocation.page].freeBlocks;
+    size_t offset = allocation.offset;
+    size_t size = allocation.size;
+
+    // Merge with the free blocks on either side
+    auto nextIt = freeBlocks.lower_bound(offset);
+    if (nextIt != freeBlocks.end() && nextIt->first == offset + size) {
+        size += nextIt->second;
+        nextIt = freeBlocks.erase(nextIt);
+    }
+    if (nextIt != freeBlocks.begin()) {
+        auto previousIt = std::prev(nextIt);
+        if (previousIt->first + previousIt->second == offset) {
+            offset = previousIt->first;
+            size += previousIt->second;
+            freeBlocks.erase(previousIt);
+        }
+    }
+    freeBlocks[offset] = size;
+
+    liveBytes -= allocation.size;
+    numAllocations--;
+    allocation = Allocation();
+}
+
+void BufferArena::upload(const Allocation& allocation, const void* data, 
+                         size_t size) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pages[allocation.page].buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLuint BufferArena::getBuffer(int page) {
+    return pages[page].buffer;
+}
+
+size_t BufferArena::getNumPages() {
+    return pages.size();
+}
+
+size_t BufferArena::getCapacity() {
+    size_t capacity = 0;
+    for (auto& page : pages) {
+        capacity += page.size;
+    }
+    return capacity;
+}
+
+size_t BufferArena::getLiveBytes() {
+    return liveBytes;
+}
+
+size_t BufferArena::getNumAllocations() {
+    return numAllocations;
+}
+
+float BufferArena::getFragmentation() {
+    size_t freeBytes = 0;
+    size_t largestFreeBytes = 0;
+    for (auto& page : pages) {
+        size_t largestFreeBlock = 0;
+        for (auto& freeBlock : page.freeBlocks) {
+            freeBytes += freeBlock.second;
+            largestFreeBlock = std::max(largestFreeBlock, freeBlock.second);
+        }
+        largestFreeBytes += largestFreeBlock;
+    }
+    if (freeBytes == 0) {
+        return 0.0f;
+    }
+    return 1.0f - largestFreeBytes / (float)freeBytes;
+}
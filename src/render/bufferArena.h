@@ -0,0 +1,106 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef BUFFERARENA_H
+#define BUFFERARENA_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/**
+  * Sub-allocates slices of a few large GL buffers ("pages"), so that tiles
+  * do not each need buffers of their own. Free space within a page is kept
+  * in a free-list, and neighbouring free blocks are merged. Pages are never
+  * released before the arena is destroyed.
+  */
+class BufferArena {
+public:
+    typedef struct Allocation {
+        int page = -1;        /*< -1 if nothing is allocated */
+        size_t offset = 0;    /*< In bytes from the start of the page */
+        size_t size = 0;      /*< In bytes, including alignment padding */
+    } Allocation;
+
+/**
+  * @param pageSize Size of a new page in bytes. Larger allocations get a 
+  *                 page of their own.
+  * @param alignment Allocation offsets and sizes are multiples of this.
+  */
+    BufferArena(size_t pageSize, size_t alignment);
+
+    ~BufferArena();
+
+/**
+  * Allocates a slice of at least size bytes, adding a page if none has room.
+  */
+    Allocation allocate(size_t size);
+
+/**
+  * Returns the slice to its page, and resets the allocation.
+  */
+    void free(Allocation& allocation);
+
+/**
+  * Copies data into the start of an allocation, which must be large enough.
+  */
+    void upload(const Allocation& allocation, const void* data, size_t size);
+
+    GLuint getBuffer(int page);
+
+    size_t getNumPages();
+
+    size_t getCapacity(); /*< Bytes in all pages */
+
+    size_t getLiveBytes(); /*< Bytes in live allocations */
+
+    size_t getNumAllocations();
+
+/**
+  * @return Share of the free space outside the largest free block of its 
+  *         page. 0 when each page's free space is contiguous, approaching 1
+  *         as it splinters.
+  */
+    float getFragmentation();
+
+private:
+    typedef struct Page {
+        GLuint buffer;
+        size_t size;
+        std::map<size_t, size_t> freeBlocks; /*< Offset to size */
+    } Page;
+
+    size_t pageSize;
+    size_t alignment;
+
+    std::vector<Page> pages;
+
+    size_t liveBytes = 0;
+    size_t numAllocations = 0;
+
+    int addPage(size_t size);
+};
+
+#endif
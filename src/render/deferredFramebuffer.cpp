@@ -23,6 +23,7 @@ SOFTWARE.
 ==============================================================================*/
 #include "deferredFramebuffer.h"
 
+#include <algorithm>
 #include <iostream>
 
 DeferredFramebuffer::DeferredFramebuffer(int w, int h) {
@@ -35,6 +36,15 @@ DeferredFramebuffer::DeferredFramebuffer(int w, int h) {
     generateDeferredFBO(w, h);
     generateOcclusionFBO(w, h);
     generatePostFBO(w, h);
+
+    GLsizeiptr readbackSize = (2 * MAX_ID_RADIUS + 1) * (2 * MAX_ID_RADIUS + 1)
+                            * sizeof(GLuint);
+    for (IDReadback& readback : idReadbacks) {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, readbackSize, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 }
 
 DeferredFramebuffer::~DeferredFramebuffer() {
@@ -49,6 +59,12 @@ DeferredFramebuffer::~DeferredFramebuffer() {
     glDeleteFramebuffers(1, &occlusionFBO);
     glDeleteFramebuffers(1, &postFBO);
     glDeleteRenderbuffers(1, &depthBuffer);
+    for (IDReadback& readback : idReadbacks) {
+        if (readback.fence != 0) {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.buffer);
+    }
 }
 
 // Note: depth buffer to render buffer?
@@ -62,10 +78,10 @@ void DeferredFramebuffer::generateDeferredFBO(int w, int h) {
     glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
 
-    // Normal buffer
+    // Normal buffer, with the baked ambient occlusion in alpha
     glGenTextures(1, &fboNormal);
     glBindTexture(GL_TEXTURE_2D, fboNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -76,10 +92,10 @@ void DeferredFramebuffer::generateDeferredFBO(int w, int h) {
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    // Colour id
+    // Colour id, an exact 32 bit integer per pixel for picking
     glGenTextures(1, &fboColourID);
     glBindTexture(GL_TEXTURE_2D, fboColourID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8UI, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, w, h, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -159,17 +175,26 @@ void DeferredFramebuffer::generatePostFBO(int w, int h) {
 void DeferredFramebuffer::resize(int w, int h) {
     width = w; height = h;
 
+    // Copies in flight are of the old image
+    for (IDReadback& readback : idReadbacks) {
+        if (readback.fence != 0) {
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+        }
+    }
+    ids.clear();
+
     glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
 
     glBindTexture(GL_TEXTURE_2D, fboNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
     glBindTexture(GL_TEXTURE_2D, fboDiffuse);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
 
     glBindTexture(GL_TEXTURE_2D, fboColourID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, w, h, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
 
     glBindTexture(GL_TEXTURE_2D, fboOcclusion);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
@@ -182,6 +207,9 @@ void DeferredFramebuffer::renderTo() {
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, deferredFBO);
     
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // glClear is undefined for integer buffers. Draw buffer 3 is the ID.
+    const GLuint noID[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 3, noID);
     glEnable(GL_DEPTH_TEST);
 }
 
@@ -218,20 +246,103 @@ GLuint& DeferredFramebuffer::getDepthTexture() {
     return fboDepth;
 }
 
-unsigned int DeferredFramebuffer::getID(glm::vec2 coordinates) {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, deferredFBO);
+void DeferredFramebuffer::readIDs(glm::vec2 coordinates, int radius) {
+    collectIDs();
+    IDReadback& readback = idReadbacks[nextReadback];
+    if (readback.fence != 0) {
+        return;
+    }
+    radius = std::min(radius, (int)MAX_ID_RADIUS);
     GLint xCoordinate = coordinates.x;
     GLint yCoordinate = height - coordinates.y;
+    glm::ivec2 from = glm::max(glm::ivec2(xCoordinate - radius, 
+                                          yCoordinate - radius), 
+                               glm::ivec2(0));
+    glm::ivec2 to = glm::min(glm::ivec2(xCoordinate + radius + 1, 
+                                        yCoordinate + radius + 1), 
+                             glm::ivec2(width, height));
+    if (to.x <= from.x || to.y <= from.y) {
+        return;
+    }
+    readback.region = glm::ivec4(from, to - from);
+    readback.centre = glm::ivec2(xCoordinate, yCoordinate);
 
-    float depthValue[4];
-
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, deferredFBO);
     glReadBuffer(GL_COLOR_ATTACHMENT2);
-    glReadPixels(xCoordinate, yCoordinate, 1, 1, GL_RGBA, GL_FLOAT, depthValue);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glReadPixels(from.x, from.y, readback.region.z, readback.region.w, 
+                 GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    nextReadback = 1 - nextReadback;
+}
+
+void DeferredFramebuffer::collectIDs() {
+    // Oldest first, so that the newest finished copy is kept
+    for (int i = 0; i < 2; i++) {
+        IDReadback& readback = idReadbacks[(nextReadback + i) % 2];
+        if (readback.fence == 0) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(readback.fence, 
+                                         GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED 
+         && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(readback.fence);
+        readback.fence = 0;
+
+        size_t numIDs = readback.region.z * readback.region.w;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const GLuint* mapped = (const GLuint*)glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, numIDs * sizeof(GLuint), 
+            GL_MAP_READ_BIT);
+        if (mapped != nullptr) {
+            ids.assign(mapped, mapped + numIDs);
+            idRegion = readback.region;
+            idCentre = readback.centre;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
 
-    unsigned int rNorm = depthValue[0] * 255;
-    unsigned int gNorm = depthValue[1] * 255;
-    unsigned int bNorm = depthValue[2] * 255;
+unsigned int DeferredFramebuffer::getID(glm::vec2 coordinates, 
+                                        int snapRadius) {
+    collectIDs();
+    GLint xCoordinate = coordinates.x;
+    GLint yCoordinate = height - coordinates.y;
 
-    unsigned int id = (rNorm << 16) ^ (gNorm << 8) ^ bNorm;
+    if (ids.empty()) {
+        return 0;
+    }
+    glm::ivec2 local = glm::ivec2(xCoordinate, yCoordinate) 
+                     - glm::ivec2(idRegion);
+    if (local.x < 0 || local.y < 0 
+     || local.x >= idRegion.z || local.y >= idRegion.w) {
+        // The cursor moved off the copied region. Renderer::finish copies 
+        // the new one for the next frame.
+        // Clamped, as a region at the edge of the frame may not hold it
+        local = glm::clamp(idCentre - glm::ivec2(idRegion), glm::ivec2(0),
+                           glm::ivec2(idRegion.z, idRegion.w) - 1);
+    }
+
+    unsigned int id = ids[local.x + local.y * idRegion.z];
+    if (id != 0 || snapRadius <= 0) {
+        return id;
+    }
+    int nearest = snapRadius * snapRadius + 1;
+    for (int y = 0; y < idRegion.w; y++) {
+        for (int x = 0; x < idRegion.z; x++) {
+            int distance = (x - local.x) * (x - local.x) 
+                         + (y - local.y) * (y - local.y);
+            if (distance < nearest && ids[x + y * idRegion.z] != 0) {
+                nearest = distance;
+                id = ids[x + y * idRegion.z];
+            }
+        }
+    }
     return id;
 }
\ No newline at end of file
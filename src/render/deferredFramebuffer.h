@@ -31,6 +31,8 @@ SOFTWARE.
 
 class DeferredFramebuffer {
 public:
+    static const int MAX_ID_RADIUS = 4; /*< Largest region readIDs can copy */
+
     DeferredFramebuffer(int w, int h);
 
     void generateDeferredFBO(int w, int h);
@@ -53,9 +55,44 @@ public:
 
     float getDepth(glm::vec2 coordinates);
 
-    unsigned int getID(glm::vec2 coordinates);
+/**
+  * Starts copying the IDs around the coordinates into a pixel buffer, to be
+  * picked up by getID once the GPU is done, usually by the next frame. Two 
+  * buffers take turns, and a request is skipped if both are still in flight,
+  * so that the CPU never waits. Call once the frame's IDs are drawn.
+  *
+  * @param radius Pixels copied on each side, at most MAX_ID_RADIUS
+  */
+    void readIDs(glm::vec2 coordinates, int radius);
+
+/**
+  * Looks the ID up in the latest finished copy, without ever waiting on the
+  * GPU. If the copy does not cover the coordinates, e.g. while the cursor 
+  * moves, the ID at the coordinates the copy was requested for is returned,
+  * a frame late. Returns 0 until the first copy is done.
+  *
+  * @param snapRadius If there is no ID at the coordinates, the nearest one 
+  *                   within this many pixels is returned instead
+  */
+    unsigned int getID(glm::vec2 coordinates, int snapRadius);
 
 private:
+    typedef struct IDReadback {
+        GLuint buffer;    /*< Pixel pack buffer */
+        GLsync fence = 0; /*< Set while the copy is in flight */
+        glm::ivec4 region; /*< x, y, width and height, from the bottom left */
+        glm::ivec2 centre; /*< Coordinates the copy was requested for */
+    } IDReadback;
+
+    IDReadback idReadbacks[2];
+    int nextReadback = 0; /*< Also the older of the two when both are used */
+
+    std::vector<unsigned int> ids; /*< Of the latest finished copy */
+    glm::ivec4 idRegion = glm::ivec4(0);
+    glm::ivec2 idCentre = glm::ivec2(0);
+
+    void collectIDs();
+
     GLuint deferredFBO;
     GLuint occlusionFBO;
     GLuint postFBO;
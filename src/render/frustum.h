@@ -0,0 +1,50 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../../lib/glm/gtc/type_ptr.hpp"
+
+/**
+  * View frustum extracted from a world to clip matrix, used for culling
+  * axis-aligned bounding boxes on the CPU.
+  */
+class Frustum {
+public:
+    Frustum(const glm::mat4& worldToClipMatrix);
+
+/**
+  * Checks whether an axis-aligned box is at least partially inside the
+  * frustum. The test is conservative: boxes near the frustum corners may be
+  * reported as visible even when they are not.
+  */
+    bool intersects(glm::vec3 minBound, glm::vec3 maxBound) const;
+
+private:
+    // Left, right, bottom, top. The near and far planes are left out, as depth
+    // clamping is enabled and geometry past them is still drawn.
+    glm::vec4 planes[4];
+};
+
+#endif
@@ -502,6 +502,32 @@ bool GuiScene::input(glm::vec2 coordinates, int button, int state,
     glm::vec2 relativeCoordinates = coordinates - glm::vec2(hardDimensions);
     std::vector<std::string> ids = {"scene"};
 
+    if (selecting != Selecting::NONE) {
+        if (button == -1 && selecting == Selecting::BOX) {
+            selectionOutline[2] = relativeCoordinates;
+        } else if (button == -1 && glm::length(relativeCoordinates 
+                                  - selectionOutline.back()) > 2.0f) {
+            selectionOutline.push_back(relativeCoordinates);
+        }
+        if (state == 0) {
+            if (selecting == Selecting::BOX) {
+                glm::vec2 from = selectionOutline[0];
+                glm::vec2 to = selectionOutline[2];
+                selectionOutline = {from, glm::vec2(to.x, from.y), 
+                                    to, glm::vec2(from.x, to.y)};
+            }
+            std::vector<glm::vec3> args;
+            for (glm::ivec3 location : renderer->selectBlocks(
+                     scene, selectionOutline)) {
+                args.push_back(glm::vec3(location));
+            }
+            eventManager->addEvent(ids, Action::SELECT_BLOCKS, args);
+            selecting = Selecting::NONE;
+            selectionOutline.clear();
+        }
+        return true;
+    }
+
     if (coordinates.x <= hardDimensions.z 
      && coordinates.x >= hardDimensions.x 
      && coordinates.y <= hardDimensions.w 
@@ -515,7 +541,17 @@ bool GuiScene::input(glm::vec2 coordinates, int button, int state,
                                                    location, normal);
 
         //std::cout << "Tile ID: " << tileId << std::endl;
-        if (button == 1 && state == 1) {
+        if (button == 1 && state == 1 
+         && (mods & (GLFW_MOD_SHIFT | GLFW_MOD_CONTROL))) {
+            if (mods & GLFW_MOD_SHIFT) {
+                selecting = Selecting::BOX;
+                selectionOutline = {relativeCoordinates, relativeCoordinates,
+                                    relativeCoordinates};
+            } else {
+                selecting = Selecting::LASSO;
+                selectionOutline = {relativeCoordinates};
+            }
+        } else if (button == 1 && state == 1) {
             if (hitModel) {
                 std::vector<glm::vec3> args = {glm::vec3(location), normal, 
                                                glm::vec3(relativeCoordinates, 
@@ -154,6 +154,15 @@ private:
     bool removeBlocks = false;
     glm::ivec3 initialLocation;
     glm::vec3 initialNormal;
+
+    // Shift-dragging selects with a box, control-dragging with a lasso
+    enum class Selecting {
+        NONE,
+        BOX,
+        LASSO
+    };
+    Selecting selecting = Selecting::NONE;
+    std::vector<glm::vec2> selectionOutline;
 };
 
 /* GUI Button ----------------------------------------------------------------*/
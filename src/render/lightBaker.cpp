@@ -0,0 +1,411 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "lightBaker.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Directions traced from every cell, spread evenly over the sphere
+static const int numDirections = 32;
+
+// Distance between samples along a ray, in blocks
+static const float stepLength = 0.4f;
+
+// Passes of light bouncing off the blocks
+static const int numBounces = 2;
+
+// Light from the sky above and the ground below the horizon, the share of
+// light the blocks reflect, and the light assumed where a ray hits outside
+// the traced cells
+static const glm::vec3 skyLight(0.95f, 0.95f, 1.0f);
+static const glm::vec3 groundLight(0.4f, 0.37f, 0.33f);
+static const float albedo = 0.6f;
+static const glm::vec3 ambientLight(0.5f);
+
+// Bakes started per update, as the neighbourhood of each is copied on the
+// main thread
+static const int maxBakesPerUpdate = 16;
+
+static const glm::ivec3 faceDirections[LightBaker::NUM_FACES] = {
+    glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0),
+    glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+};
+
+static const int ESCAPED = -1; // The ray left the neighbourhood unblocked
+static const int UNTRACED = -2; // The ray hit next to a cell not traced
+
+static const std::vector<glm::vec3>& getDirections() {
+    static const std::vector<glm::vec3> directions = [] {
+        // Fibonacci sphere
+        std::vector<glm::vec3> points;
+        const float goldenAngle = 3.14159265f * (3.0f - std::sqrt(5.0f));
+        for (int i = 0; i < numDirections; i++) {
+            float y = 1.0f - (i + 0.5f) * 2.0f / numDirections;
+            float radius = std::sqrt(1.0f - y * y);
+            float angle = goldenAngle * i;
+            points.push_back(glm::vec3(std::cos(angle) * radius, y, 
+                                       std::sin(angle) * radius));
+        }
+        return points;
+    }();
+    return directions;
+}
+
+static glm::vec3 getEnvironment(glm::vec3 direction) {
+    float t = glm::clamp(direction.y * 2.0f + 0.5f, 0.0f, 1.0f);
+    return groundLight + (skyLight - groundLight) * t;
+}
+
+LightBaker::LightBaker(glm::ivec3 tileDimensions, unsigned int numThreads)
+                      : tileDimensions(tileDimensions) {
+    slotSize = glm::ivec3(tileDimensions.x * NUM_FACES, tileDimensions.y, 
+                          tileDimensions.z);
+
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_3D, atlas);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    resizeAtlas(1);
+
+    if (numThreads == 0) {
+        // Leaves the rest of the cores to meshing
+        unsigned int numCores = std::thread::hardware_concurrency();
+        numThreads = numCores > 1 ? numCores / 2 : 1;
+    }
+    for (unsigned int i = 0; i < numThreads; i++) {
+        threads.push_back(std::thread(&LightBaker::run, this));
+    }
+}
+
+LightBaker::~LightBaker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    jobAdded.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    glDeleteTextures(1, &atlas);
+}
+
+void LightBaker::invalidate(glm::ivec3 tileLocation) {
+    for (auto& light : tiles) {
+        glm::ivec3 distance = glm::abs(light.location - tileLocation);
+        if (light.used && std::max(distance.x, std::max(distance.y, 
+                                                        distance.z)) <= 1) {
+            light.dirty = true;
+        }
+    }
+}
+
+void LightBaker::update(Scene* scene) {
+    std::vector<Result> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(results);
+    }
+
+    glBindTexture(GL_TEXTURE_3D, atlas);
+    for (auto& result : finished) {
+        TileLight& light = tiles[result.tileHandle];
+        // The slot may have been taken by another tile since
+        if (!light.pending || light.location != result.location) {
+            continue;
+        }
+        light.pending = false;
+        light.texels = std::move(result.texels);
+        uploadSlot(result.tileHandle);
+        numBaked++;
+    }
+
+    int numStarted = 0;
+    for (auto tile : scene->getTiles()) {
+        if (tile->handle >= tiles.size()) {
+            tiles.resize(tile->handle + 1);
+        }
+        TileLight& light = tiles[tile->handle];
+        if (!light.used || light.location != tile->location) {
+            light = TileLight();
+            light.location = tile->location;
+            light.used = true;
+        }
+        if (light.revision != tile->revision) {
+            light.dirty = true;
+        }
+        if (!light.dirty || light.pending || numStarted >= maxBakesPerUpdate) {
+            continue;
+        }
+        light.revision = tile->revision;
+        light.dirty = false;
+        light.pending = true;
+        numStarted++;
+
+        Job job = makeJob(scene, tile);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        jobAdded.notify_one();
+    }
+}
+
+size_t LightBaker::getNumJobs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + numBaking;
+}
+
+size_t LightBaker::getCPUBytes() {
+    size_t bytes = 0;
+    for (auto& light : tiles) {
+        bytes += light.texels.capacity();
+    }
+    return bytes;
+}
+
+void LightBaker::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return !running || !jobs.empty(); });
+            if (!running) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            numBaking++;
+        }
+
+        Result result;
+        result.tileHandle = job.tileHandle;
+        result.location = job.location;
+        bake(job, result.texels);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+        numBaking--;
+    }
+}
+
+LightBaker::Job LightBaker::makeJob(Scene* scene, Scene::Tile* tile) {
+    Job job;
+    job.tileHandle = tile->handle;
+    job.location = tile->location;
+
+    glm::ivec3 size = tileDimensions * 3;
+    job.solid.resize(size.x * size.y * size.z, 0);
+    for (int i = 0; i < 27; i++) {
+        glm::ivec3 side(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1);
+        Scene::Tile* neighbour = side == glm::ivec3(0) 
+                               ? tile : scene->getTile(tile->location + side);
+        if (neighbour == nullptr) {
+            continue;
+        }
+        glm::ivec3 origin = (side + 1) * tileDimensions;
+        for (size_t j = 0; j < neighbour->blocks.size(); j++) {
+            if (neighbour->blocks[j].blockType 
+             == Scene::Block::BlockType::EMPTY) {
+                continue;
+            }
+            glm::ivec3 cell = origin + scene->getBlockLocation(j);
+            job.solid[cell.x + cell.y * size.x + cell.z * size.x * size.y] = 1;
+        }
+    }
+    return job;
+}
+
+void LightBaker::bake(const Job& job, std::vector<uint8_t>& texels) const {
+    glm::ivec3 size = tileDimensions * 3;
+    auto isSolid = [&](glm::ivec3 cell) {
+        if (cell.x < 0 || cell.y < 0 || cell.z < 0 
+         || cell.x >= size.x || cell.y >= size.y || cell.z >= size.z) {
+            return false;
+        }
+        return job.solid[cell.x + cell.y * size.x 
+                       + cell.z * size.x * size.y] != 0;
+    };
+
+    // Light is traced from the cells of the tile and those around it, as
+    // the faces of its blocks are lit by the cells in front of them
+    glm::ivec3 tracedFrom = tileDimensions - 1;
+    glm::ivec3 tracedSize = tileDimensions + 2;
+    int numTraced = tracedSize.x * tracedSize.y * tracedSize.z;
+    auto getTracedIndex = [&](glm::ivec3 cell) {
+        glm::ivec3 local = cell - tracedFrom;
+        if (local.x < 0 || local.y < 0 || local.z < 0 || local.x >= tracedSize.x
+         || local.y >= tracedSize.y || local.z >= tracedSize.z) {
+            return -1;
+        }
+        return local.x + local.y * tracedSize.x 
+             + local.z * tracedSize.x * tracedSize.y;
+    };
+    auto getTracedCell = [&](int index) {
+        return tracedFrom + glm::ivec3(index % tracedSize.x, 
+                                       (index / tracedSize.x) % tracedSize.y,
+                                       index / (tracedSize.x * tracedSize.y));
+    };
+
+    // Where each ray ends: the open cell it was in before hitting a block,
+    // or whether it escaped
+    const std::vector<glm::vec3>& directions = getDirections();
+    float maxDistance = std::min(tileDimensions.x, 
+                                 std::min(tileDimensions.y, tileDimensions.z));
+    std::vector<int> hits(numTraced * numDirections, ESCAPED);
+    for (int i = 0; i < numTraced; i++) {
+        glm::ivec3 cell = getTracedCell(i);
+        if (isSolid(cell)) {
+            continue;
+        }
+        glm::vec3 origin(cell);
+        for (int d = 0; d < numDirections; d++) {
+            glm::ivec3 previous = cell;
+            for (float t = stepLength; t <= maxDistance; t += stepLength) {
+                glm::vec3 point = origin + directions[d] * t;
+                glm::ivec3 next(std::floor(point.x + 0.5f), 
+                                std::floor(point.y + 0.5f),
+                                std::floor(point.z + 0.5f));
+                if (next == previous) {
+                    continue;
+                }
+                if (isSolid(next)) {
+                    int hit = getTracedIndex(previous);
+                    hits[i * numDirections + d] = hit < 0 ? UNTRACED : hit;
+                    break;
+                }
+                previous = next;
+            }
+        }
+    }
+
+    // Each bounce gathers the light of the previous one off the blocks hit
+    std::vector<glm::vec3> light(numTraced, ambientLight);
+    auto getIncoming = [&](int cell, int d) {
+        int hit = hits[cell * numDirections + d];
+        if (hit == ESCAPED) {
+            return getEnvironment(directions[d]);
+        }
+        return albedo * (hit == UNTRACED ? ambientLight : light[hit]);
+    };
+    for (int bounce = 0; bounce < numBounces; bounce++) {
+        std::vector<glm::vec3> gathered(numTraced, glm::vec3(0.0f));
+        for (int i = 0; i < numTraced; i++) {
+            if (isSolid(getTracedCell(i))) {
+                continue;
+            }
+            for (int d = 0; d < numDirections; d++) {
+                gathered[i] += getIncoming(i, d);
+            }
+            gathered[i] /= (float)numDirections;
+        }
+        light.swap(gathered);
+    }
+
+    // Irradiance of each visible face, cosine weighted over the hemisphere
+    // in front of it. Hidden faces take the mean of the visible ones, as 
+    // slopes sample the face of their dominant axis.
+    texels.assign(slotSize.x * slotSize.y * slotSize.z * 4, 255);
+    for (int z = 0; z < tileDimensions.z; z++) {
+        for (int y = 0; y < tileDimensions.y; y++) {
+            for (int x = 0; x < tileDimensions.x; x++) {
+                glm::ivec3 block(x, y, z);
+                glm::ivec3 cell = block + tileDimensions;
+                if (!isSolid(cell)) {
+                    continue;
+                }
+
+                glm::vec3 irradiance[NUM_FACES];
+                bool visible[NUM_FACES];
+                glm::vec3 visibleSum(0.0f);
+                int numVisible = 0;
+                for (int f = 0; f < NUM_FACES; f++) {
+                    glm::ivec3 front = cell + faceDirections[f];
+                    visible[f] = !isSolid(front);
+                    if (!visible[f]) {
+                        continue;
+                    }
+                    int traced = getTracedIndex(front);
+                    glm::vec3 normal(faceDirections[f]);
+                    glm::vec3 sum(0.0f);
+                    float weights = 0.0f;
+                    for (int d = 0; d < numDirections; d++) {
+                        float weight = glm::dot(directions[d], normal);
+                        if (weight > 0.0f) {
+                            sum += getIncoming(traced, d) * weight;
+                            weights += weight;
+                        }
+                    }
+                    irradiance[f] = sum / weights;
+                    visibleSum += irradiance[f];
+                    numVisible++;
+                }
+
+                for (int f = 0; f < NUM_FACES; f++) {
+                    if (!visible[f]) {
+                        irradiance[f] = numVisible > 0 
+                                      ? visibleSum / (float)numVisible 
+                                      : ambientLight;
+                    }
+                    glm::vec3 value = glm::clamp(irradiance[f], 0.0f, 1.0f);
+                    size_t texel = ((x * NUM_FACES + f) + y * slotSize.x 
+                                  + z * slotSize.x * slotSize.y) * 4;
+                    texels[texel    ] = (uint8_t)std::round(value.r * 255.0f);
+                    texels[texel + 1] = (uint8_t)std::round(value.g * 255.0f);
+                    texels[texel + 2] = (uint8_t)std::round(value.b * 255.0f);
+                }
+            }
+        }
+    }
+}
+
+void LightBaker::resizeAtlas(int layers) {
+    atlasLayers = layers;
+    glm::ivec3 size(slotSize.x * SLOTS_PER_ROW, slotSize.y * SLOTS_PER_COLUMN,
+                    slotSize.z * layers);
+    // Unbaked slots leave the tiles unlit
+    std::vector<uint8_t> white(size.x * size.y * size.z * 4, 255);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, size.x, size.y, size.z, 0, 
+                 GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (!tiles[i].texels.empty()) {
+            uploadSlot(i);
+        }
+    }
+}
+
+void LightBaker::uploadSlot(unsigned int handle) {
+    int layer = handle / (SLOTS_PER_ROW * SLOTS_PER_COLUMN);
+    if (layer >= atlasLayers) {
+        // Grows by doubling, which uploads every slot again
+        resizeAtlas(std::max(layer + 1, atlasLayers * 2));
+        return;
+    }
+    glm::ivec3 slot(handle % SLOTS_PER_ROW, 
+                    handle / SLOTS_PER_ROW % SLOTS_PER_COLUMN, layer);
+    glm::ivec3 offset = slot * slotSize;
+    glTexSubImage3D(GL_TEXTURE_3D, 0, offset.x, offset.y, offset.z, 
+                    slotSize.x, slotSize.y, slotSize.z, GL_RGBA, 
+                    GL_UNSIGNED_BYTE, tiles[handle].texels.data());
+}
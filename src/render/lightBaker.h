@@ -0,0 +1,137 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef LIGHTBAKER_H
+#define LIGHTBAKER_H
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../lib/glm/gtc/type_ptr.hpp"
+#include "../scene.h"
+
+/**
+  * Bakes static lighting for tiles on background threads: sky light plus a 
+  * couple of bounces, traced through the voxel grid of each tile and its
+  * neighbours. The irradiance reaching each block face is kept in a 3D 
+  * texture atlas with a slot per tile handle, which the entity shader reads 
+  * once per vertex.
+  *
+  * Slot layout: the texel of face f of block (x, y, z) of the tile with 
+  * handle h is at (slot.x * 6 * dimensions.x + x * 6 + f, slot.y * 
+  * dimensions.y + y, slot.z * dimensions.z + z), where slot is 
+  * (h % SLOTS_PER_ROW, h / SLOTS_PER_ROW % SLOTS_PER_COLUMN, 
+  * h / (SLOTS_PER_ROW * SLOTS_PER_COLUMN)). Faces are +x, -x, +y, -y, +z, -z.
+  */
+class LightBaker {
+public:
+    static const int NUM_FACES = 6;
+    static const int SLOTS_PER_ROW = 16;
+    static const int SLOTS_PER_COLUMN = 16;
+
+/**
+  * @param tileDimensions Of the scene. Light is traced up to a tile away.
+  * @param numThreads Number of threads, or 0 for half of the cores
+  */
+    LightBaker(glm::ivec3 tileDimensions, unsigned int numThreads = 0);
+
+    ~LightBaker();
+
+/**
+  * Marks the tile and its neighbours for baking, as the light reaching 
+  * them depends on its blocks. Changed tiles are found by their revision 
+  * anyway, but their neighbours are not.
+  */
+    void invalidate(glm::ivec3 tileLocation);
+
+/**
+  * Uploads the bakes finished since the last call, and starts new bakes 
+  * for tiles without an up to date one. Call once per frame.
+  */
+    void update(Scene* scene);
+
+    GLuint getTexture() { return atlas; }
+
+    size_t getNumJobs();
+
+    unsigned long long getNumBaked() { return numBaked; }
+
+    size_t getCPUBytes();
+
+private:
+    typedef struct Job {
+        unsigned int tileHandle;
+        glm::ivec3 location;
+        std::vector<uint8_t> solid; /*< The tile and its 26 neighbours */
+    } Job;
+
+    typedef struct Result {
+        unsigned int tileHandle;
+        glm::ivec3 location;
+        std::vector<uint8_t> texels; /*< RGBA of the tile's slot */
+    } Result;
+
+    typedef struct TileLight {
+        glm::ivec3 location;
+        unsigned int revision = 0; /*< Of the tile when last queued */
+        bool used = false; /*< The slot belongs to the tile at location */
+        bool dirty = true; /*< Needs another bake */
+        bool pending = false; /*< Being baked */
+        std::vector<uint8_t> texels; /*< Kept for when the atlas grows */
+    } TileLight;
+
+    glm::ivec3 tileDimensions;
+    glm::ivec3 slotSize; /*< In texels */
+
+    std::vector<TileLight> tiles; /*< Indexed by tile handle */
+    unsigned long long numBaked = 0;
+
+    GLuint atlas;
+    int atlasLayers = 0; /*< Slot layers along z */
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    size_t numBaking = 0;
+    bool running = true;
+
+    void run();
+
+    Job makeJob(Scene* scene, Scene::Tile* tile);
+
+    void bake(const Job& job, std::vector<uint8_t>& texels) const;
+
+    void resizeAtlas(int layers);
+
+    void uploadSlot(unsigned int handle);
+};
+
+#endif
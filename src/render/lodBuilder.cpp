@@ -0,0 +1,131 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "lodBuilder.h"
+
+TileMesh* LodBuilder::build(const std::vector<Scene::Block>& blocks,
+                            glm::ivec3 tileDimensions, int level, 
+                            MeshScratch& scratch) {
+    int factor = 1 << level;
+    glm::ivec3 cells = tileDimensions / factor;
+
+    auto getBlockIndex = [&](glm::ivec3 blockLocation) {
+        return blockLocation.x + blockLocation.y * tileDimensions.x
+             + blockLocation.z * tileDimensions.x * tileDimensions.y;
+    };
+
+    // Majority vote, ties counting as solid so that walls one block thick
+    // survive the first level. Each solid cell remembers one of its blocks
+    // as the colour ID for picking.
+    ScratchVector<int>& cellBlocks = scratch.cells;
+    cellBlocks.assign(cells.x * cells.y * cells.z, -1);
+    for (int z = 0; z < cells.z; z++) {
+        for (int y = 0; y < cells.y; y++) {
+            for (int x = 0; x < cells.x; x++) {
+                int occupied = 0;
+                int firstBlock = -1;
+                for (int i = 0; i < factor * factor * factor; i++) {
+                    glm::ivec3 blockLocation = glm::ivec3(x, y, z) * factor
+                        + glm::ivec3(i % factor, (i / factor) % factor, 
+                                     i / (factor * factor));
+                    int index = getBlockIndex(blockLocation);
+                    if (blocks[index].blockType 
+                     != Scene::Block::BlockType::EMPTY) {
+                        occupied++;
+                        if (firstBlock == -1) firstBlock = index;
+                    }
+                }
+                if (occupied * 2 >= factor * factor * factor) {
+                    cellBlocks[x + y * cells.x + z * cells.x * cells.y] = 
+                        firstBlock;
+                }
+            }
+        }
+    }
+
+    auto isSolid = [&](glm::ivec3 cell) {
+        if (glm::any(glm::lessThan(cell, glm::ivec3(0)))
+         || glm::any(glm::greaterThanEqual(cell, cells))) {
+            // Neighbouring tiles are not known here, so faces on the tile
+            // boundary are always kept
+            return false;
+        }
+        return cellBlocks[cell.x + cell.y * cells.x 
+                        + cell.z * cells.x * cells.y] != -1;
+    };
+
+    TileMesh* tileMesh = TileMesh::acquire();
+    float halfSize = factor * 0.5f;
+
+    for (int i = 0; i < (int)cellBlocks.size(); i++) {
+        if (cellBlocks[i] == -1) {
+            continue;
+        }
+        glm::ivec3 cell(i % cells.x, (i / cells.x) % cells.y, 
+                        i / (cells.x * cells.y));
+        // Blocks are centred on integer coordinates
+        glm::vec3 centre = glm::vec3(cell * factor) + (factor - 1) * 0.5f;
+
+        for (int axis = 0; axis < 3; axis++) {
+            for (int side = -1; side <= 1; side += 2) {
+                glm::ivec3 neighbour = cell;
+                neighbour[axis] += side;
+                if (isSolid(neighbour)) {
+                    continue;
+                }
+                glm::vec3 normal(0.0f);
+                normal[axis] = side;
+
+                // Corners in counter-clockwise order seen from outside
+                int u = (axis + 1) % 3;
+                int v = (axis + 2) % 3;
+                glm::vec3 corners[4];
+                const float cornerSigns[4][2] = {
+                    {-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}
+                };
+                for (int j = 0; j < 4; j++) {
+                    int k = side > 0 ? j : 3 - j;
+                    corners[j] = centre + normal * halfSize;
+                    corners[j][u] += cornerSigns[k][0] * halfSize;
+                    corners[j][v] += cornerSigns[k][1] * halfSize;
+                }
+
+                unsigned int colourID = TileMesh::getColourID(normal, 
+                                                              cellBlocks[i]);
+                glm::vec3 triangles[2][3] = {
+                    {corners[0], corners[1], corners[2]},
+                    {corners[0], corners[2], corners[3]}
+                };
+                // Too coarse for the occlusion to be worth baking
+                const uint8_t ambient[3] = {255, 255, 255};
+                tileMesh->addTriangle(triangles[0], normal, colourID, 
+                                      cellBlocks[i], ambient);
+                tileMesh->addTriangle(triangles[1], normal, colourID, 
+                                      cellBlocks[i], ambient);
+            }
+        }
+    }
+
+    tileMesh->sortBuckets(scratch);
+    return tileMesh;
+}
@@ -0,0 +1,55 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef LODBUILDER_H
+#define LODBUILDER_H
+
+#include <vector>
+
+#include "tileMesh.h"
+#include "../scene.h"
+
+/**
+  * Builds reduced detail meshes of tiles. At level n the tile is downsampled
+  * into cells of 2^n blocks per side, and each cell becomes a cube if at least
+  * half of its blocks are occupied. Works on a copy of the blocks, so that it
+  * can run outside the main thread.
+  */
+class LodBuilder {
+public:
+    static const int NUM_LEVELS = 3; /*< Full detail, 2x and 4x */
+
+/**
+  * @param blocks Snapshot of the tile's blocks
+  * @param tileDimensions Size of a tile, in blocks
+  * @param level Level of detail, from 1 to NUM_LEVELS - 1
+  * @param scratch Buffers of the calling thread
+  * @return The mesh, taken from the TileMesh pool. It has no vertices if 
+  *         every cell was left empty.
+  */
+    static TileMesh* build(const std::vector<Scene::Block>& blocks,
+                           glm::ivec3 tileDimensions, int level, 
+                           MeshScratch& scratch);
+};
+
+#endif
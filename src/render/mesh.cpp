@@ -0,0 +1,129 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "mesh.h"
+#include "../scene.h"
+
+#include <cstdlib>
+#include <iostream>
+
+// Triangles of a quad for each variant, as offsets from its first vertex
+static const unsigned char quadTriangles[Mesh::NUM_VARIANTS][2][3] = {
+    {{0, 0, 0}, {0, 0, 0}}, // HIDDEN
+    {{0, 1, 2}, {0, 2, 3}}, // WHOLE
+    {{0, 2, 3}, {0, 0, 0}}, // SE_HALF
+    {{3, 0, 1}, {0, 0, 0}}, // SW_HALF
+    {{1, 2, 3}, {0, 0, 0}}, // NE_HALF
+    {{0, 1, 2}, {0, 0, 0}}  // NW_HALF
+};
+static const unsigned char numQuadTriangles[Mesh::NUM_VARIANTS] = {
+    0, 2, 1, 1, 1, 1
+};
+
+// Axis directions with the visibility table side of the block looked at, and
+// the side of the block itself
+static const struct {
+    glm::ivec3 direction;
+    int neighbourSide;
+    int ownSide;
+} sides[6] = {
+    {glm::ivec3( 1,  0,  0), 1, 3},
+    {glm::ivec3(-1,  0,  0), 3, 1},
+    {glm::ivec3( 0,  1,  0), 4, 5},
+    {glm::ivec3( 0, -1,  0), 5, 4},
+    {glm::ivec3( 0,  0,  1), 0, 2},
+    {glm::ivec3( 0,  0, -1), 2, 0}
+};
+
+Mesh::FaceVariant Mesh::Face::getVariant(int visibility, 
+                                         int ownVisibility) const {
+    if (triangle) {
+        // Sloped sides are hidden when the two half sides cover each other
+        int criteria = normal.y != 0 ? 0 : 1;
+        if (abs(visibility + ownVisibility) != criteria && ownVisibility != -1)
+            return WHOLE;
+        return HIDDEN;
+    }
+    switch (visibility) {
+    case 1:
+        return WHOLE;
+    case Scene::SE:
+        return SE_HALF;
+    case Scene::SW:
+        return SW_HALF;
+    case Scene::NE:
+        return NE_HALF;
+    case Scene::NW:
+        return NW_HALF;
+    default:
+        return HIDDEN;
+    }
+}
+
+void Mesh::buildFaces() {
+    faces.clear();
+    size_t faceStart = 0;
+    for (size_t j = 1; j <= normals.size(); j++) {
+        if (j < normals.size() && normals[j] == normals[faceStart]) {
+            continue;
+        }
+        size_t faceSize = j - faceStart;
+        if (faceSize < 3) {
+            std::cout << "Skipping a face of " << faceSize << " vertices" 
+                      << std::endl;
+            faceStart = j;
+            continue;
+        }
+        // Longer runs have always been drawn as their last four vertices
+        size_t firstVertex = faceSize == 3 ? faceStart : j - 4;
+
+        Face face;
+        face.normal = normals[faceStart];
+        face.neighbour = glm::ivec3(0);
+        for (auto& side : sides) {
+            if (face.normal == glm::vec3(side.direction)) {
+                face.neighbour = side.direction;
+                face.neighbourSide = side.neighbourSide;
+                face.ownSide = side.ownSide;
+            }
+        }
+        face.triangle = faceSize == 3;
+
+        for (int variant = 0; variant < NUM_VARIANTS; variant++) {
+            if (face.triangle) {
+                face.numTriangles[variant] = variant == WHOLE ? 1 : 0;
+            } else {
+                face.numTriangles[variant] = numQuadTriangles[variant];
+            }
+            for (int t = 0; t < 2; t++) {
+                for (int v = 0; v < 3; v++) {
+                    unsigned char offset = face.triangle ? v 
+                                         : quadTriangles[variant][t][v];
+                    face.triangles[variant][t][v] = firstVertex + offset;
+                }
+            }
+        }
+        faces.push_back(face);
+        faceStart = j;
+    }
+}
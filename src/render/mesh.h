@@ -28,9 +28,54 @@ SOFTWARE.
 #include "../../lib/glm/gtc/type_ptr.hpp"
 
 struct Mesh {
+/**
+  * Triangles of a face that are drawn, picked by the visibility of the 
+  * block the face looks at. The corner variants keep half of a quad.
+  */
+    enum FaceVariant {
+        HIDDEN,
+        WHOLE,
+        SE_HALF,
+        SW_HALF,
+        NE_HALF,
+        NW_HALF,
+        NUM_VARIANTS
+    };
+
+/**
+  * A run of three or four consecutive vertices sharing a normal, with 
+  * everything the meshers need to decide what to draw of it.
+  */
+    typedef struct Face {
+        glm::vec3 normal;
+        glm::ivec3 neighbour;   /*< Offset of the block the face looks at */
+        int neighbourSide = -1; /*< Neighbour's side facing back, or -1 if the
+                                    face is not axis aligned */
+        int ownSide = 0;        /*< Side of the block the face lies on */
+        bool triangle = false;  /*< Otherwise a quad */
+
+        unsigned char numTriangles[NUM_VARIANTS];
+        unsigned short triangles[NUM_VARIANTS][2][3]; /*< Vertex indices */
+
+/**
+  * @param visibility Visibility of the neighbour's side facing the face
+  * @param ownVisibility Visibility of the face's own side, as given by 
+  *                      Scene::checkVisibilityDirection. Only triangles
+  *                      use it.
+  */
+        FaceVariant getVariant(int visibility, int ownVisibility) const;
+    } Face;
+
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec3> normals;
     std::vector<unsigned int> indices;
+    std::vector<Face> faces; /*< Filled in by buildFaces */
+
+/**
+  * Groups the vertices into faces. Called once the vertices and normals are
+  * final, so that the meshers never compare normals themselves.
+  */
+    void buildFaces();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,227 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "../scene.h"
+
+/**
+  * Identifies the content a tile model was built from.
+  */
+typedef struct ContentKey {
+    unsigned long long hash;
+    int level;
+
+    bool operator==(const ContentKey& other) const {
+        return hash == other.hash && level == other.level;
+    }
+
+/**
+  * @param blocks Blocks the model is built from, apron included
+  * @param level Level of detail of the model
+  */
+    static ContentKey fromBlocks(const std::vector<Scene::Block>& blocks, 
+                                 int level) {
+        // 64-bit FNV-1a over the fields of each block
+        ContentKey key;
+        key.hash = 14695981039346656037ull;
+        auto add = [&](unsigned char byte) {
+            key.hash = (key.hash ^ byte) * 1099511628211ull;
+        };
+        for (const Scene::Block& block : blocks) {
+            add(block.rotation);
+            add(block.flipped);
+            add((unsigned char)block.blockType);
+        }
+        key.level = level;
+        return key;
+    }
+} ContentKey;
+
+struct ContentKeyHash {
+    size_t operator()(const ContentKey& key) const {
+        return key.hash ^ key.level;
+    }
+};
+
+/**
+  * Shares models between tiles of identical content, so that repeated tiles
+  * are meshed and uploaded once. Models are reference counted. Models no 
+  * tile uses are kept for reuse until they no longer fit in the memory cap,
+  * least recently used going first.
+  */
+template <typename Model>
+class MeshCache {
+public:
+/**
+  * @param capacity Bytes that unused models may take up
+  * @param deleteModel Called for models that leave the cache
+  */
+    MeshCache(size_t capacity, std::function<void(Model*)> deleteModel) 
+        : capacity(capacity), deleteModel(deleteModel) { }
+
+    ~MeshCache() {
+        for (auto& entryPair : entries) {
+            deleteModel(entryPair.second.model);
+        }
+    }
+
+/**
+  * @param blocks Compared with the cached model's, as hashes may collide
+  * @return The model with a reference added, or nullptr if not cached
+  */
+    Model* acquire(const ContentKey& key, 
+                   const std::vector<Scene::Block>& blocks) {
+        auto entryIt = entries.find(key);
+        if (entryIt == entries.end() 
+         || !isSameContent(entryIt->second.blocks, blocks)) {
+            return nullptr;
+        }
+        retain(key);
+        return entryIt->second.model;
+    }
+
+/**
+  * Adds a new model. A model already cached under the key, which can only
+  * happen on a hash collision, is replaced if nothing uses it.
+  *
+  * @param references References held by the caller
+  * @param size Memory the model takes up, in bytes
+  */
+    void insert(const ContentKey& key, std::vector<Scene::Block> blocks, 
+                Model* model, unsigned int references, size_t size) {
+        auto entryIt = entries.find(key);
+        if (entryIt != entries.end()) {
+            if (entryIt->second.references > 0) {
+                // Nothing to share it under; lives as long as its users
+                uncached.insert(std::make_pair(model, references));
+                return;
+            }
+            remove(entryIt);
+        }
+        Entry& entry = entries[key];
+        entry.blocks = std::move(blocks);
+        entry.model = model;
+        entry.references = references;
+        entry.size = size + entry.blocks.size() * sizeof(Scene::Block);
+        if (references == 0) {
+            makeIdle(key, entry);
+        }
+    }
+
+    void retain(const ContentKey& key) {
+        Entry& entry = entries.at(key);
+        if (entry.references++ == 0) {
+            idleBytes -= entry.size;
+            idle.erase(entry.idleIt);
+        }
+    }
+
+    void release(const ContentKey& key, Model* model) {
+        auto uncachedIt = uncached.find(model);
+        if (uncachedIt != uncached.end()) {
+            if (--uncachedIt->second == 0) {
+                deleteModel(model);
+                uncached.erase(uncachedIt);
+            }
+            return;
+        }
+        Entry& entry = entries.at(key);
+        if (--entry.references == 0) {
+            makeIdle(key, entry);
+        }
+    }
+
+    static bool isSameContent(const std::vector<Scene::Block>& a,
+                              const std::vector<Scene::Block>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].rotation != b[i].rotation || a[i].flipped != b[i].flipped
+             || a[i].blockType != b[i].blockType) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t getNumModels() { return entries.size(); }
+
+    size_t getNumIdle() { return idle.size(); }
+
+    size_t getIdleBytes() { return idleBytes; }
+
+    size_t getCapacity() { return capacity; }
+
+    unsigned long long getNumEvictions() { return evictions; }
+
+private:
+    typedef struct Entry {
+        Model* model;
+        std::vector<Scene::Block> blocks;
+        unsigned int references = 0;
+        size_t size = 0; /*< Of the model and the blocks, in bytes */
+        typename std::list<ContentKey>::iterator idleIt; /*< If unused */
+    } Entry;
+
+    size_t capacity;
+    std::function<void(Model*)> deleteModel;
+
+    std::unordered_map<ContentKey, Entry, ContentKeyHash> entries;
+    std::list<ContentKey> idle; /*< Unused models, most recently used first */
+    size_t idleBytes = 0;
+    unsigned long long evictions = 0;
+
+    std::unordered_map<Model*, unsigned int> uncached; /*< Lost a collision */
+
+    void makeIdle(const ContentKey& key, Entry& entry) {
+        idle.push_front(key);
+        entry.idleIt = idle.begin();
+        idleBytes += entry.size;
+        while (idleBytes > capacity) {
+            evictions++;
+            remove(entries.find(idle.back()));
+        }
+    }
+
+    void remove(typename std::unordered_map<ContentKey, Entry, 
+                                            ContentKeyHash>::iterator entryIt) {
+        Entry& entry = entryIt->second;
+        if (entry.references == 0) {
+            idleBytes -= entry.size;
+            idle.erase(entry.idleIt);
+        }
+        deleteModel(entry.model);
+        entries.erase(entryIt);
+    }
+};
+
+#endif
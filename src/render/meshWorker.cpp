@@ -0,0 +1,102 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "meshWorker.h"
+
+MeshWorker::MeshWorker(unsigned int numThreads) {
+    if (numThreads == 0) {
+        // hardware_concurrency may return 0 when it cannot tell
+        unsigned int numCores = std::thread::hardware_concurrency();
+        numThreads = numCores > 1 ? numCores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < numThreads; i++) {
+        threads.push_back(std::thread(&MeshWorker::run, this));
+    }
+}
+
+MeshWorker::~MeshWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    jobAdded.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto result : results) {
+        TileMesh::release(result.tileMesh);
+    }
+}
+
+void MeshWorker::addJob(const Job& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    jobAdded.notify_one();
+}
+
+std::vector<MeshWorker::Result> MeshWorker::takeResults() {
+    std::vector<Result> finished;
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.swap(results);
+    return finished;
+}
+
+unsigned int MeshWorker::getNumThreads() {
+    return threads.size();
+}
+
+size_t MeshWorker::getNumJobs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + numBuilding;
+}
+
+void MeshWorker::run() {
+    MeshScratch scratch; // Kept for the lifetime of the thread
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return !running || !jobs.empty(); });
+            if (!running) {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+            numBuilding++;
+        }
+
+        Result result;
+        result.tileHandle = job.tileHandle;
+        result.revision = job.revision;
+        result.level = job.level;
+        result.contentHash = job.contentHash;
+        result.tileMesh = job.build(scratch);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(result);
+        numBuilding--;
+    }
+}
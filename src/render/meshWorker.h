@@ -0,0 +1,96 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef MESHWORKER_H
+#define MESHWORKER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tileMesh.h"
+
+/**
+  * Builds tile meshes on a pool of background threads. Jobs must not touch 
+  * the scene, so they are given copies of whatever they need. Finished 
+  * meshes are collected by the renderer, which uploads them on the main 
+  * thread.
+  */
+class MeshWorker {
+public:
+    typedef struct Job {
+        unsigned int tileHandle;
+        unsigned int revision; /*< Revision of the tile the job was made from */
+        int level;
+        unsigned long long contentHash; /*< See ContentKey */
+        std::function<TileMesh*(MeshScratch&)> build;
+    } Job;
+
+    typedef struct Result {
+        unsigned int tileHandle;
+        unsigned int revision;
+        int level;
+        unsigned long long contentHash;
+        TileMesh* tileMesh; /*< Owned by whoever takes the result */
+    } Result;
+
+/**
+  * @param numThreads Number of threads, or 0 to leave one core to the main
+  *                   thread
+  */
+    MeshWorker(unsigned int numThreads = 0);
+
+    ~MeshWorker();
+
+    void addJob(const Job& job);
+
+/**
+  * Removes and returns every finished result.
+  */
+    std::vector<Result> takeResults();
+
+    unsigned int getNumThreads();
+
+/**
+  * @return Jobs queued or being built
+  */
+    size_t getNumJobs();
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    size_t numBuilding = 0;
+
+    bool running = true;
+
+    void run();
+};
+
+#endif
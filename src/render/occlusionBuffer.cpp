@@ -0,0 +1,195 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "occlusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Box corner i has the max x bound if bit 0 is set, max y if bit 1, max z if 
+// bit 2. Faces wind counter-clockwise when seen from the outside.
+static const int boxTriangles[12][3] = {
+    {0, 2, 3}, {0, 3, 1},   // -z
+    {4, 5, 7}, {4, 7, 6},   // +z
+    {0, 4, 6}, {0, 6, 2},   // -x
+    {1, 3, 7}, {1, 7, 5},   // +x
+    {0, 1, 5}, {0, 5, 4},   // -y
+    {2, 6, 7}, {2, 7, 3}    // +y
+};
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) 
+                                : width((width + 3) & ~3), height(height) {
+    depth.resize(this->width * this->height, FLT_MAX);
+}
+
+void OcclusionBuffer::clear(const glm::mat4& worldToClipMatrix) {
+    this->worldToClipMatrix = worldToClipMatrix;
+    std::fill(depth.begin(), depth.end(), FLT_MAX);
+}
+
+bool OcclusionBuffer::projectBox(glm::vec3 minBound, glm::vec3 maxBound, 
+                                 glm::vec3 corners[8]) const {
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner((i & 1) ? maxBound.x : minBound.x,
+                         (i & 2) ? maxBound.y : minBound.y,
+                         (i & 4) ? maxBound.z : minBound.z, 1.0f);
+        glm::vec4 clip = worldToClipMatrix * corner;
+        // Boxes crossing the near plane are not handled, callers treat them as
+        // visible (or skip them, for occluders)
+        if (clip.w < 0.001f) {
+            return false;
+        }
+        corners[i] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * width,
+                               (clip.y / clip.w * 0.5f + 0.5f) * height,
+                               clip.z / clip.w);
+    }
+    return true;
+}
+
+void OcclusionBuffer::addOccluder(glm::vec3 minBound, glm::vec3 maxBound) {
+    glm::vec3 corners[8];
+    if (!projectBox(minBound, maxBound, corners)) {
+        return;
+    }
+    for (int i = 0; i < 12; i++) {
+        rasterizeTriangle(corners[boxTriangles[i][0]],
+                          corners[boxTriangles[i][1]],
+                          corners[boxTriangles[i][2]]);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, 
+                                        glm::vec3 v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area <= 0.0f) {
+        return; // Back facing or degenerate
+    }
+
+    int minX = std::max(0, (int)floor(std::min(v0.x, std::min(v1.x, v2.x))));
+    int maxX = std::min(width - 1, 
+                        (int)ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+    int minY = std::max(0, (int)floor(std::min(v0.y, std::min(v1.y, v2.y))));
+    int maxY = std::min(height - 1, 
+                        (int)ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+    minX &= ~3; // Rows are processed four pixels at a time
+
+    // Edge functions, evaluated at pixel centers: e = a * x + b * y + c
+    float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+    float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+    float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+    // Depth is linear in screen space: z = zA * x + zB * y + zC
+    float invArea = 1.0f / area;
+    float zA = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+    float zB = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+    float zC = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float* row = &depth[y * width];
+#if defined(__SSE2__)
+        __m128 zero = _mm_setzero_ps();
+        __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), 
+                                   _mm_set1_ps(b0 * py + c0));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), 
+                                   _mm_set1_ps(b1 * py + c1));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), 
+                                   _mm_set1_ps(b2 * py + c2));
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                            _mm_and_ps(_mm_cmpge_ps(e1, zero),
+                                       _mm_cmpge_ps(e2, zero)));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), 
+                                  _mm_set1_ps(zB * py + zC));
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(current, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                             _mm_andnot_ps(inside, current)));
+        }
+#else
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            if (a0 * px + b0 * py + c0 < 0.0f
+             || a1 * px + b1 * py + c1 < 0.0f
+             || a2 * px + b2 * py + c2 < 0.0f) {
+                continue;
+            }
+            row[x] = std::min(row[x], zA * px + zB * py + zC);
+        }
+#endif
+    }
+}
+
+bool OcclusionBuffer::isOccluded(glm::vec3 minBound, 
+                                 glm::vec3 maxBound) const {
+    glm::vec3 corners[8];
+    if (!projectBox(minBound, maxBound, corners)) {
+        return false;
+    }
+    glm::vec3 screenMin = corners[0];
+    glm::vec3 screenMax = corners[0];
+    for (int i = 1; i < 8; i++) {
+        screenMin = glm::min(screenMin, corners[i]);
+        screenMax = glm::max(screenMax, corners[i]);
+    }
+
+    int minX = std::max(0, (int)floor(screenMin.x));
+    int maxX = std::min(width - 1, (int)ceil(screenMax.x));
+    int minY = std::max(0, (int)floor(screenMin.y));
+    int maxY = std::min(height - 1, (int)ceil(screenMax.y));
+    if (minX > maxX || minY > maxY) {
+        return false; // Off screen, leave it to the frustum test
+    }
+
+    for (int y = minY; y <= maxY; y++) {
+        const float* row = &depth[y * width];
+        int x = minX;
+#if defined(__SSE2__)
+        __m128 boxDepth = _mm_set1_ps(screenMin.z);
+        for (; x + 3 <= maxX; x += 4) {
+            __m128 occluderDepth = _mm_loadu_ps(row + x);
+            if (_mm_movemask_ps(_mm_cmpge_ps(occluderDepth, boxDepth)) != 0) {
+                return false;
+            }
+        }
+#endif
+        for (; x <= maxX; x++) {
+            if (row[x] >= screenMin.z) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
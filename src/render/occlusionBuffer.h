@@ -0,0 +1,75 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include <vector>
+
+#include "../../lib/glm/gtc/type_ptr.hpp"
+
+/**
+  * Low resolution depth buffer for culling tiles on the CPU. Solid boxes are
+  * rasterized into the buffer as occluders, after which boxes can be tested
+  * against it. Both the rasterization and the tests handle four pixels at a
+  * time with SSE where available.
+  */
+class OcclusionBuffer {
+public:
+/**
+  * @param width Width of the buffer in pixels, rounded up to a multiple of 4.
+  * @param height Height of the buffer in pixels.
+  */
+    OcclusionBuffer(int width, int height);
+
+/**
+  * Clears the buffer, and sets the projection used by subsequent calls.
+  */
+    void clear(const glm::mat4& worldToClipMatrix);
+
+/**
+  * Rasterizes an axis-aligned box. The box must be completely solid, as any
+  * geometry behind it is considered hidden.
+  */
+    void addOccluder(glm::vec3 minBound, glm::vec3 maxBound);
+
+/**
+  * Checks whether an axis-aligned box is hidden behind the occluders added 
+  * since the last clear.
+  */
+    bool isOccluded(glm::vec3 minBound, glm::vec3 maxBound) const;
+
+private:
+    int width, height;
+
+    std::vector<float> depth; /*< Normalized device depth, nearest wins */
+
+    glm::mat4 worldToClipMatrix;
+
+    bool projectBox(glm::vec3 minBound, glm::vec3 maxBound, 
+                    glm::vec3 corners[8]) const;
+
+    void rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+};
+
+#endif
@@ -0,0 +1,259 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "rayPicker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Steps through the cells of a grid in the order a ray crosses them
+typedef struct GridWalk {
+    glm::ivec3 cell;
+    glm::ivec3 step;
+    glm::vec3 next;  // Distance at which the ray leaves the cell, per axis
+    glm::vec3 delta; // Distance between cell borders, per axis
+    float enter;     // Distance at which the ray entered the cell
+    int axis;        // Axis of the border crossed to enter the cell
+
+    GridWalk(glm::vec3 origin, glm::vec3 direction, glm::vec3 cellSize,
+             float enter, int axis, glm::ivec3 minCell, glm::ivec3 maxCell) 
+            : enter(enter), axis(axis) {
+        glm::vec3 point = origin + direction * enter;
+        cell = glm::clamp(glm::ivec3(glm::floor(point / cellSize)), 
+                          minCell, maxCell);
+        for (int i = 0; i < 3; i++) {
+            if (direction[i] > 0.0f) {
+                step[i] = 1;
+                next[i] = ((cell[i] + 1) * cellSize[i] - origin[i]) 
+                        / direction[i];
+                delta[i] = cellSize[i] / direction[i];
+            } else if (direction[i] < 0.0f) {
+                step[i] = -1;
+                next[i] = (cell[i] * cellSize[i] - origin[i]) / direction[i];
+                delta[i] = -cellSize[i] / direction[i];
+            } else {
+                step[i] = 0;
+                next[i] = FLT_MAX;
+                delta[i] = FLT_MAX;
+            }
+        }
+    }
+
+    float getExit() const {
+        return std::min(next.x, std::min(next.y, next.z));
+    }
+
+    void advance() {
+        axis = next.x < next.y ? (next.x < next.z ? 0 : 2)
+                               : (next.y < next.z ? 1 : 2);
+        enter = next[axis];
+        cell[axis] += step[axis];
+        next[axis] += delta[axis];
+    }
+} GridWalk;
+
+// Clips a ray to a box. The axis is replaced by that of the face the ray 
+// enters through, if it enters after minDistance.
+static bool clipRay(glm::vec3 origin, glm::vec3 direction, glm::vec3 minBound,
+                    glm::vec3 maxBound, float& enter, float& exit, int& axis) {
+    float near = -FLT_MAX;
+    int nearAxis = -1;
+    float far = FLT_MAX;
+    for (int i = 0; i < 3; i++) {
+        if (direction[i] == 0.0f) {
+            if (origin[i] < minBound[i] || origin[i] > maxBound[i]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (minBound[i] - origin[i]) / direction[i];
+        float t1 = (maxBound[i] - origin[i]) / direction[i];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        if (t0 > near) {
+            near = t0;
+            nearAxis = i;
+        }
+        far = std::min(far, t1);
+    }
+    if (near > enter) {
+        enter = near;
+        axis = nearAxis;
+    }
+    exit = std::min(exit, far);
+    return enter <= exit;
+}
+
+RayPicker::RayPicker(const TileMesher* mesher) : mesher(mesher) {
+}
+
+bool RayPicker::pick(Scene* scene, glm::vec3 origin, glm::vec3 direction, 
+                     float maxDistance, Hit& hit) {
+    Clock::time_point start = Clock::now();
+    bool found = false;
+
+    glm::ivec3 minTile, maxTile;
+    float length = glm::length(direction);
+    if (length > 0.0f && scene->getTileRange(minTile, maxTile)) {
+        direction /= length;
+        // Moved by half a block, so that block b spans b to b + 1
+        glm::vec3 gridOrigin = origin + glm::vec3(0.5f);
+        glm::vec3 tileSize(scene->getTileDimensions());
+
+        float enter = 0.0f;
+        float exit = maxDistance;
+        int axis = -1;
+        if (clipRay(gridOrigin, direction, glm::vec3(minTile) * tileSize,
+                    glm::vec3(maxTile + 1) * tileSize, enter, exit, axis)) {
+            GridWalk walk(gridOrigin, direction, tileSize, enter, axis, 
+                          minTile, maxTile);
+            while (!found && walk.enter <= exit 
+                && glm::all(glm::greaterThanEqual(walk.cell, minTile))
+                && glm::all(glm::lessThanEqual(walk.cell, maxTile))) {
+                Scene::Tile* tile = scene->getTile(walk.cell);
+                glm::vec3 minBound, maxBound;
+                if (scene->getTileBounds(tile, minBound, maxBound)) {
+                    float tileEnter = walk.enter;
+                    float tileExit = std::min(walk.getExit(), exit);
+                    int tileAxis = walk.axis;
+                    if (clipRay(gridOrigin, direction, 
+                                minBound + glm::vec3(0.5f), 
+                                maxBound + glm::vec3(0.5f), 
+                                tileEnter, tileExit, tileAxis)) {
+                        found = pickTile(scene, tile, gridOrigin, direction,
+                                         tileEnter, tileExit, tileAxis, hit);
+                    }
+                }
+                walk.advance();
+            }
+        }
+    }
+    if (found) {
+        hit.point -= glm::vec3(0.5f);
+    }
+
+    double time = std::chrono::duration<double, std::micro>(
+        Clock::now() - start).count();
+    stats.picks++;
+    stats.totalTime += time;
+    stats.maxTime = std::max(stats.maxTime, time);
+    return found;
+}
+
+bool RayPicker::pickTile(Scene* scene, Scene::Tile* tile, glm::vec3 origin, 
+                         glm::vec3 direction, float enter, float exit, 
+                         int entryAxis, Hit& hit) {
+    glm::ivec3 dimensions = scene->getTileDimensions();
+    glm::ivec3 tileOrigin = tile->location * dimensions;
+
+    GridWalk walk(origin, direction, glm::vec3(1.0f), enter, entryAxis,
+                  tileOrigin + tile->minBlock, tileOrigin + tile->maxBlock);
+    while (walk.enter <= exit
+        && glm::all(glm::greaterThanEqual(walk.cell, 
+                                          tileOrigin + tile->minBlock))
+        && glm::all(glm::lessThanEqual(walk.cell, 
+                                       tileOrigin + tile->maxBlock))) {
+        stats.blocksVisited++;
+        glm::ivec3 local = walk.cell - tileOrigin;
+        const Scene::Block& block = tile->blocks[local.x 
+            + local.y * dimensions.x + local.z * dimensions.x * dimensions.y];
+
+        if (block.blockType == Scene::Block::BlockType::CUBE) {
+            hit.location = walk.cell;
+            hit.normal = glm::vec3(0.0f);
+            if (walk.axis >= 0) {
+                hit.normal[walk.axis] = (float)-walk.step[walk.axis];
+            } else {
+                // Starting inside the cube, so face the ray's main axis
+                glm::vec3 absolute = glm::abs(direction);
+                int axis = absolute.x > absolute.y 
+                         ? (absolute.x > absolute.z ? 0 : 2)
+                         : (absolute.y > absolute.z ? 1 : 2);
+                hit.normal[axis] = direction[axis] > 0.0f ? -1.0f : 1.0f;
+            }
+            hit.distance = walk.enter;
+            hit.point = origin + direction * walk.enter;
+            return true;
+        }
+        if (block.blockType != Scene::Block::BlockType::EMPTY) {
+            const Mesh* mesh = mesher->getShape(block);
+            if (mesh != nullptr 
+             && intersectShape(mesh, glm::vec3(walk.cell) + glm::vec3(0.5f), 
+                               origin, direction, enter, hit)) {
+                hit.location = walk.cell;
+                return true;
+            }
+        }
+        walk.advance();
+    }
+    return false;
+}
+
+bool RayPicker::intersectShape(const Mesh* mesh, glm::vec3 center, 
+                               glm::vec3 origin, glm::vec3 direction, 
+                               float minDistance, Hit& hit) const {
+    const float epsilon = 1e-6f;
+    float nearest = FLT_MAX;
+    for (const Mesh::Face& face : mesh->faces) {
+        // Back faces are culled when drawing, so they can't be picked
+        if (glm::dot(face.normal, direction) >= 0.0f) {
+            continue;
+        }
+        for (int t = 0; t < face.numTriangles[Mesh::WHOLE]; t++) {
+            const unsigned short* triangle = face.triangles[Mesh::WHOLE][t];
+            glm::vec3 v0 = mesh->vertices[triangle[0]] + center;
+            glm::vec3 edge1 = mesh->vertices[triangle[1]] + center - v0;
+            glm::vec3 edge2 = mesh->vertices[triangle[2]] + center - v0;
+
+            glm::vec3 p = glm::cross(direction, edge2);
+            float determinant = glm::dot(edge1, p);
+            if (std::abs(determinant) < epsilon) {
+                continue;
+            }
+            float inverse = 1.0f / determinant;
+            glm::vec3 s = origin - v0;
+            float u = glm::dot(s, p) * inverse;
+            if (u < 0.0f || u > 1.0f) {
+                continue;
+            }
+            glm::vec3 q = glm::cross(s, edge1);
+            float v = glm::dot(direction, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f) {
+                continue;
+            }
+            float distance = glm::dot(edge2, q) * inverse;
+            if (distance >= minDistance && distance < nearest) {
+                nearest = distance;
+                hit.normal = face.normal;
+            }
+        }
+    }
+    if (nearest == FLT_MAX) {
+        return false;
+    }
+    hit.distance = nearest;
+    hit.point = origin + direction * nearest;
+    return true;
+}
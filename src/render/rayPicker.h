@@ -0,0 +1,100 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef RAYPICKER_H
+#define RAYPICKER_H
+
+#include <chrono>
+
+#include "../../lib/glm/gtc/type_ptr.hpp"
+
+#include "mesh.h"
+#include "tileMesher.h"
+#include "../scene.h"
+
+/**
+  * Picks blocks on the CPU by casting rays through the scene, so that the 
+  * cursor never waits on the GPU. The ray walks the grid of tiles and then 
+  * the blocks of each occupied tile it crosses (3D-DDA), stopping at the 
+  * first block it hits. Cubes are hit where the ray enters them, other 
+  * shapes are intersected triangle by triangle.
+  */
+class RayPicker {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    typedef struct Hit {
+        glm::ivec3 location; /*< World location of the block */
+        glm::vec3 normal;    /*< Normal of the face hit, as in the shape */
+        glm::vec3 point;     /*< Where the ray meets the face */
+        float distance;      /*< From the ray's origin */
+    } Hit;
+
+    typedef struct Stats {
+        unsigned long long picks = 0;
+        unsigned long long blocksVisited = 0;
+        double totalTime = 0.0; /*< Microseconds spent picking */
+        double maxTime = 0.0;   /*< Of a single pick */
+    } Stats;
+
+/**
+  * @param mesher Gives the shapes of the blocks. It must outlive the picker.
+  */
+    RayPicker(const TileMesher* mesher);
+
+/**
+  * @param direction Need not be normalized
+  * @param maxDistance Blocks further away are not picked
+  * @return Whether a block was hit, in which case hit is filled in
+  */
+    bool pick(Scene* scene, glm::vec3 origin, glm::vec3 direction, 
+              float maxDistance, Hit& hit);
+
+    const Stats& getStats() { return stats; }
+
+private:
+    const TileMesher* mesher;
+
+    Stats stats;
+
+/**
+  * Walks the blocks of a tile between the given distances.
+  *
+  * @param entryAxis Axis of the face the ray enters the tile's blocks 
+  *                  through, or -1 if it starts inside them
+  */
+    bool pickTile(Scene* scene, Scene::Tile* tile, glm::vec3 origin, 
+                  glm::vec3 direction, float enter, float exit, int entryAxis,
+                  Hit& hit);
+
+/**
+  * Intersects the front faces of a shape, nearest first.
+  *
+  * @param center Where the block lies
+  */
+    bool intersectShape(const Mesh* mesh, glm::vec3 center, glm::vec3 origin,
+                        glm::vec3 direction, float minDistance, 
+                        Hit& hit) const;
+};
+
+#endif
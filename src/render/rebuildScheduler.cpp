@@ -0,0 +1,95 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "rebuildScheduler.h"
+
+#include <algorithm>
+
+// Weight of the latest rebuild in the moving average of the latency
+static const float latencySmoothing = 0.1f;
+
+RebuildScheduler::RebuildScheduler(float budget) : budget(budget) { }
+
+void RebuildScheduler::add(glm::ivec3 tileLocation) {
+    if (!queued.insert(tileLocation).second) {
+        return;
+    }
+    // Queued again before its rebuild finished, so the wait goes on
+    auto startedIt = started.find(tileLocation);
+    QueuedTile tile;
+    tile.location = tileLocation;
+    tile.queued = startedIt != started.end() ? startedIt->second 
+                                             : Clock::now();
+    tile.priority = 0.0f;
+    queue.push_back(tile);
+}
+
+void RebuildScheduler::run(const std::function<float(glm::ivec3)>& priority,
+                           const std::function<void(glm::ivec3)>& rebuild) {
+    stats.rebuiltLastFrame = 0;
+    stats.lastFrameTime = 0.0f;
+    if (queue.empty()) {
+        return;
+    }
+
+    // Priorities change as the camera and the cursor move, so they are 
+    // recomputed every frame. Sorted in reverse to pop from the back.
+    for (auto& tile : queue) {
+        tile.priority = priority(tile.location);
+    }
+    std::sort(queue.begin(), queue.end(), 
+              [](const QueuedTile& a, const QueuedTile& b) {
+                  return a.priority > b.priority;
+              });
+
+    Clock::time_point start = Clock::now();
+    std::chrono::duration<float, std::milli> elapsed(0.0f);
+    while (!queue.empty() && (stats.rebuiltLastFrame == 0 
+                           || elapsed.count() < budget)) {
+        QueuedTile tile = queue.back();
+        queue.pop_back();
+        queued.erase(tile.location);
+        started[tile.location] = tile.queued;
+        rebuild(tile.location);
+
+        elapsed = Clock::now() - start;
+        stats.rebuiltLastFrame++;
+    }
+    stats.lastFrameTime = elapsed.count();
+}
+
+void RebuildScheduler::finished(glm::ivec3 tileLocation) {
+    auto startedIt = started.find(tileLocation);
+    if (startedIt == started.end()) {
+        return;
+    }
+    std::chrono::duration<float, std::milli> latency = 
+        Clock::now() - startedIt->second;
+    started.erase(startedIt);
+
+    stats.averageLatency = stats.totalRebuilt == 0 ? latency.count()
+        : stats.averageLatency 
+        + (latency.count() - stats.averageLatency) * latencySmoothing;
+    stats.maxLatency = std::max(stats.maxLatency, latency.count());
+    stats.totalRebuilt++;
+}
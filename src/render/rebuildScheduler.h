@@ -0,0 +1,119 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef REBUILDSCHEDULER_H
+#define REBUILDSCHEDULER_H
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "../../lib/glm/gtc/type_ptr.hpp"
+
+/**
+  * Queues modified tiles and spreads their rebuilds over frames. Each frame
+  * the queue is ordered by priority and rebuilds are started until the 
+  * frame's budget is spent, so that a stroke across many tiles does not
+  * stall a single frame. The budget covers starting the rebuilds, not the
+  * meshing, which is done off the main thread. Tiles keep their current 
+  * mesh until the new one is ready, at which point the renderer calls 
+  * finished.
+  */
+class RebuildScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    typedef struct Stats {
+        unsigned int rebuiltLastFrame = 0; /*< Rebuilds started */
+        float lastFrameTime = 0.0f; /*< Milliseconds spent starting them */
+        unsigned long long totalRebuilt = 0; /*< Rebuilds finished */
+        float averageLatency = 0.0f; /*< Milliseconds from queued to the new
+                                         model in place, a moving average */
+        float maxLatency = 0.0f; /*< Over every rebuild so far */
+    } Stats;
+
+/**
+  * @param budget Milliseconds per frame. At least one tile is rebuilt per
+  *               frame however long it takes.
+  */
+    RebuildScheduler(float budget);
+
+/**
+  * Queues a tile, unless it is queued already. The tile keeps its place
+  * in the latency measurements from when it was first queued.
+  */
+    void add(glm::ivec3 tileLocation);
+
+/**
+  * Rebuilds queued tiles, lowest priority value first, until the budget is
+  * spent.
+  *
+  * @param priority Lower values are rebuilt sooner
+  * @param rebuild Starts the rebuild of a tile. It may finish it too.
+  */
+    void run(const std::function<float(glm::ivec3)>& priority,
+             const std::function<void(glm::ivec3)>& rebuild);
+
+/**
+  * Records the latency of the tile's rebuild, once its new model is in 
+  * place or it is no longer needed. Tiles not rebuilt by run are ignored.
+  */
+    void finished(glm::ivec3 tileLocation);
+
+    size_t getQueueDepth() { return queue.size(); }
+
+    size_t getNumStarted() { return started.size(); }
+
+    float getBudget() { return budget; }
+
+    const Stats& getStats() { return stats; }
+
+private:
+    typedef struct QueuedTile {
+        glm::ivec3 location;
+        Clock::time_point queued;
+        float priority;
+    } QueuedTile;
+
+    struct LocationHash {
+        size_t operator()(const glm::ivec3& location) const {
+            return (size_t)location.x * 73856093 
+                 ^ (size_t)location.y * 19349663
+                 ^ (size_t)location.z * 83492791;
+        }
+    };
+
+    float budget;
+
+    std::vector<QueuedTile> queue;
+    boost::unordered_set<glm::ivec3, LocationHash> queued; /*< Of queue */
+
+    /** Rebuilds started but not finished, by when they were first queued */
+    boost::unordered_map<glm::ivec3, Clock::time_point, LocationHash> started;
+
+    Stats stats;
+};
+
+#endif
@@ -27,6 +27,48 @@ SOFTWARE.
 
 #include <fstream>
 #include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+
+// Resolution of the software depth buffer used for occlusion culling
+static const int occlusionBufferWidth = 128;
+static const int occlusionBufferHeight = 64;
+
+// Number of solid tiles rasterized as occluders per frame
+static const size_t maxOccluders = 16;
+
+// Projected tile size in pixels below which level i + 1 is drawn, and how far
+// past a threshold the size must go before the level changes back
+static const float lodThresholds[LodBuilder::NUM_LEVELS - 1] = {64.0f, 24.0f};
+static const float lodHysteresis = 0.15f;
+
+// Size of the GPU buffer pages tile meshes are allocated from
+static const size_t vertexPageSize = 4 * 1024 * 1024;
+static const size_t indexPageSize = 2 * 1024 * 1024;
+
+// Memory that models of content no tile has any more may keep, in case the 
+// content comes back
+static const size_t meshCacheSize = 16 * 1024 * 1024;
+
+// Models evicted from the cache kept for their buffer slices, which new 
+// models of a similar size take over in place
+static const size_t maxSpareModels = 64;
+
+// Milliseconds per frame spent starting the rebuilds of modified tiles, 
+// that is taking their snapshots and handing them to the mesh worker
+static const float rebuildBudget = 2.0f;
+
+// Added to the priority of tiles out of view, so that every tile in view is
+// rebuilt first
+static const float outOfViewPriority = 1.0e6f;
+
+// Pixels around the cursor that picking the colour IDs snaps from, so that
+// a cursor just past a block's edge or in a seam still picks it
+static const int pickSnapRadius = 2;
 
 // Uses degrees as opposed to radians for ease of use...
 float calcFrustumScale(float fFovDeg) {
@@ -59,6 +101,31 @@ Renderer::Renderer(int w, int h, glm::vec4 deferredArea,
 
     render2D = new Render2D(shaderManager, glm::vec2(w, h));
 
+    occlusionBuffer = new OcclusionBuffer(occlusionBufferWidth, 
+                                          occlusionBufferHeight);
+
+    meshWorker = new MeshWorker();
+    rebuildScheduler = new RebuildScheduler(rebuildBudget);
+
+    vertexArena = new BufferArena(vertexPageSize, sizeof(TileVertex));
+    indexArena = new BufferArena(indexPageSize, sizeof(GLuint));
+    meshCache = new MeshCache<ModelInfo>(meshCacheSize, 
+        [this](ModelInfo* model) { deleteModel(model); });
+
+    // Base instances pick each draw's tile data out of a buffer, so that 
+    // all of the tiles in a buffer page can be drawn with one call
+    multiDrawIndirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+    glGenBuffers(1, &drawCommandBuffer);
+    glGenBuffers(1, &drawTileDataBuffer);
+
+    glGenBuffers(1, &selectionBuffer);
+    glGenTextures(1, &selectionTex);
+
+    timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (timerQueries) {
+        glGenQueries(1, &sceneTimeQuery);
+    }
+
     glm::mat4 modelToCameraMatrix(1.0f);
     matrixStack.push(modelToCameraMatrix);
 
@@ -97,13 +164,7 @@ GLuint& Renderer::getDepthTexture() {
 
 Renderer::ModelInfo::ModelInfo() { }
 
-Renderer::ModelInfo::~ModelInfo() {
-    glDeleteBuffers(1, &vertexBufferObject);
-    glDeleteBuffers(1, &normalBufferObject);
-    glDeleteBuffers(1, &indexBufferObject);
-    glDeleteBuffers(1, &colourIDBufferObject);
-    glDeleteVertexArrays(1, &vertexArrayObject);
-}
+Renderer::ModelInfo::~ModelInfo() { }
 
 Renderer::~Renderer() {
     if (render2D != nullptr)
@@ -112,6 +173,22 @@ Renderer::~Renderer() {
         delete shaderManager;
     if (deferredFBO != nullptr)
         delete deferredFBO;
+    if (occlusionBuffer != nullptr)
+        delete occlusionBuffer;
+    if (meshWorker != nullptr)
+        delete meshWorker;
+    if (rebuildScheduler != nullptr)
+        delete rebuildScheduler;
+    if (blockInstancer != nullptr)
+        delete blockInstancer;
+    if (lightBaker != nullptr)
+        delete lightBaker;
+    if (rayPicker != nullptr)
+        delete rayPicker;
+    if (tileMesher != nullptr)
+        delete tileMesher;
+    if (timerQueries)
+        glDeleteQueries(1, &sceneTimeQuery);
 
     for (auto meshPair : halfEdgeMeshes) {
         delete meshPair.second;
@@ -123,9 +200,23 @@ Renderer::~Renderer() {
         }
     }
 
-    for (auto modelPair : models) {
-        delete modelPair.second;
+    for (auto& models : tileModels) {
+        clearTileModels(models);
+    }
+    delete meshCache;
+    for (auto model : spareModels) {
+        vertexArena->free(model->vertexAllocation);
+        indexArena->free(model->indexAllocation);
+        delete model;
     }
+    // The arenas report any slices still allocated at this point
+    delete vertexArena;
+    delete indexArena;
+    glDeleteVertexArrays(pageVertexArrays.size(), pageVertexArrays.data());
+    glDeleteBuffers(1, &drawCommandBuffer);
+    glDeleteBuffers(1, &drawTileDataBuffer);
+    glDeleteTextures(1, &selectionTex);
+    glDeleteBuffers(1, &selectionBuffer);
 
     eventManager->removeListener(id);
     delete listener;
@@ -147,11 +238,19 @@ void Renderer::update(double delta) {
         case Action::REBUILD_TILE: {
             auto eventScene = std::dynamic_pointer_cast<Event<Scene*>>(event);
             Scene* scene = eventScene->args[0];
-            std::vector<glm::ivec3>& modifiedTiles = scene->getModifiedTiles();
+            const std::vector<glm::ivec3>& modifiedTiles =
+                scene->getModifiedTiles();
+            // Started from renderScene, within the frame's budget
             for (glm::ivec3 tileLocation : modifiedTiles) {
-                rebuildTile(scene, tileLocation);
+                rebuildScheduler->add(tileLocation);
+                if (lightBaker != nullptr) {
+                    lightBaker->invalidate(tileLocation);
+                }
+                if (blockInstancer != nullptr) {
+                    blockInstancer->invalidate(tileLocation);
+                }
             }
-            modifiedTiles.clear();
+            scene->clearModifiedTiles();
             break;
         }
         case Action::TOGGLE_WIREFRAME: {
@@ -162,6 +261,33 @@ void Renderer::update(double delta) {
             }
             break;
         }
+        case Action::TOGGLE_OCCLUSION_CULLING: {
+            occlusionCulling = !occlusionCulling;
+            break;
+        }
+        case Action::TOGGLE_RADIOSITY: {
+            radiosity = !radiosity;
+            break;
+        }
+        case Action::TOGGLE_SSAO: {
+            ssao = !ssao;
+            break;
+        }
+        case Action::TOGGLE_CPU_PICKING: {
+            cpuPicking = !cpuPicking;
+            break;
+        }
+        case Action::TOGGLE_INSTANCED_BLOCKS: {
+            // Per instance attributes are core only from 3.3 onwards
+            if (!instancedBlocks && !GLEW_VERSION_3_3 
+             && !GLEW_ARB_instanced_arrays) {
+                std::cout << "Instanced blocks need GL_ARB_instanced_arrays"
+                          << std::endl;
+                break;
+            }
+            instancedBlocks = !instancedBlocks;
+            break;
+        }
         case Action::EXPORT_TILE: {
             auto eventScene = std::dynamic_pointer_cast<Event<Scene*>>(event);
             exportScene(eventScene->args[0]);
@@ -216,17 +342,32 @@ void Renderer::start() {
 }
 
 void Renderer::finish() {
+    // Copied in the background, for the picks of the next frame
+    if (!cpuPicking && idPicked) {
+        deferredFBO->readIDs(pickCoordinates, pickSnapRadius);
+    }
+
     deferredFBO->renderToOcclusion();
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     glUseProgram(shaderManager->getBaseLightingShader());
+    glUniform1i(glGetUniformLocation(
+                    shaderManager->getBaseLightingShader(), "ssao"), ssao);
+    glUniform1i(glGetUniformLocation(shaderManager->getBaseLightingShader(), 
+                                     "selectionVisible"), selectionVisible);
+    glUniform1ui(glGetUniformLocation(
+                     shaderManager->getBaseLightingShader(), "tileIDShift"),
+                 tileIDShift);
     glClearColor(57.0f / 255.0f, 57.0f / 255.0f, 57.0f / 255.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, noiseTex);
 
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_BUFFER, selectionTex);
+
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_STENCIL_TEST);
 
@@ -237,6 +378,8 @@ void Renderer::finish() {
     deferredFBO->renderToPost();
 
     glUseProgram(shaderManager->getOcclusionBlurShader());
+    glUniform1i(glGetUniformLocation(
+                    shaderManager->getOcclusionBlurShader(), "ssao"), ssao);
 
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, gaussianTex);
@@ -275,7 +418,35 @@ void Renderer::finish2D() {
 bool Renderer::getMouseLocation(Scene* scene, glm::vec2 coordinates, 
                                 glm::ivec3& returnLocation, 
                                 glm::vec3& returnNormal) {
-    unsigned int id = deferredFBO->getID(coordinates);
+    if (cpuPicking) {
+        // Unprojects the cursor onto the near and far planes
+        glm::vec2 viewport = getViewportDimensions();
+        glm::vec2 ndc(2.0f * coordinates.x / viewport.x - 1.0f,
+                      1.0f - 2.0f * coordinates.y / viewport.y);
+        glm::mat4 clipToWorldMatrix = 
+            glm::inverse(cameraToClipMatrix * worldToCameraMatrix);
+        glm::vec4 nearPoint = clipToWorldMatrix * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farPoint = clipToWorldMatrix * glm::vec4(ndc, 1.0f, 1.0f);
+        glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+        glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+        // Not limited to the far plane, as depth clamping draws past it. The
+        // ray is clipped to the scene's tiles anyway.
+        RayPicker::Hit hit;
+        if (!getRayPicker(scene)->pick(scene, origin, direction, FLT_MAX, 
+                                       hit)) {
+            return false;
+        }
+        returnLocation = hit.location;
+        // Slopes are picked as the colour IDs would, by their main axis
+        returnNormal = TileMesh::getFaceNormal(
+            TileMesh::getColourID(hit.normal, 0));
+        return true;
+    }
+
+    idPicked = true;
+    pickCoordinates = coordinates;
+    unsigned int id = deferredFBO->getID(coordinates, pickSnapRadius);
     if (id != 0) {
 
         unsigned int mask = (1 << scene->getMaxBytes()) - 1;
@@ -284,26 +455,9 @@ bool Renderer::getMouseLocation(Scene* scene, glm::vec2 coordinates,
 
         unsigned int tileId = ((~mask) & id) >> scene->getMaxBytes();
 
-        blockId--;
-
-        glm::vec3 normal(0.0f);
-
-        switch (blockId % 6) {
-        case 0:
-            normal.x =  1.0f; break;
-        case 1:
-            normal.x = -1.0f; break;
-        case 2: 
-            normal.y = -1.0f; break;
-        case 3:
-            normal.z = -1.0f; break;
-        case 4:
-            normal.y =  1.0f; break;
-        case 5:
-            normal.z =  1.0f; break;
-        }
+        glm::vec3 normal = TileMesh::getFaceNormal(blockId);
 
-        blockId /= 6;
+        blockId = (blockId - 1) / 6;
 
         glm::ivec3 idLocation = scene->getBlockLocation(blockId);
 
@@ -318,6 +472,101 @@ bool Renderer::getMouseLocation(Scene* scene, glm::vec2 coordinates,
     return false;
 }
 
+std::vector<glm::ivec3> Renderer::selectBlocks(
+        Scene* scene, const std::vector<glm::vec2>& outline) {
+    std::vector<glm::ivec3> selected;
+    if (outline.size() < 3) {
+        return selected;
+    }
+    glm::vec2 viewport = getViewportDimensions();
+    glm::mat4 worldToClipMatrix = cameraToClipMatrix * worldToCameraMatrix;
+    glm::vec3 eye = glm::vec3(glm::inverse(worldToCameraMatrix)
+                            * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+    glm::vec2 minOutline = outline[0];
+    glm::vec2 maxOutline = outline[0];
+    for (glm::vec2 point : outline) {
+        minOutline = glm::min(minOutline, point);
+        maxOutline = glm::max(maxOutline, point);
+    }
+
+    // To screen coordinates, false if behind the camera
+    auto project = [&](glm::vec3 point, glm::vec2& screen) {
+        glm::vec4 clip = worldToClipMatrix * glm::vec4(point, 1.0f);
+        if (clip.w <= 0.0f) {
+            return false;
+        }
+        screen = glm::vec2((clip.x / clip.w + 1.0f) * 0.5f * viewport.x,
+                           (1.0f - clip.y / clip.w) * 0.5f * viewport.y);
+        return true;
+    };
+
+    // Even-odd rule
+    auto inside = [&](glm::vec2 point) {
+        bool in = false;
+        for (size_t i = 0, j = outline.size() - 1; i < outline.size(); j = i++) {
+            glm::vec2 a = outline[i];
+            glm::vec2 b = outline[j];
+            if ((a.y > point.y) != (b.y > point.y)
+             && point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x) {
+                in = !in;
+            }
+        }
+        return in;
+    };
+
+    RayPicker* picker = getRayPicker(scene);
+    glm::ivec3 dimensions = scene->getTileDimensions();
+    for (Scene::Tile* tile : scene->getTiles()) {
+        glm::vec3 minBound, maxBound;
+        if (!scene->getTileBounds(tile, minBound, maxBound)) {
+            continue;
+        }
+        // Tiles reaching behind the camera are always tested block by block
+        glm::vec2 minScreen(FLT_MAX);
+        glm::vec2 maxScreen(-FLT_MAX);
+        bool behind = false;
+        for (int i = 0; i < 8 && !behind; i++) {
+            glm::vec3 corner((i & 1) ? maxBound.x : minBound.x,
+                             (i & 2) ? maxBound.y : minBound.y,
+                             (i & 4) ? maxBound.z : minBound.z);
+            glm::vec2 screen;
+            behind = !project(corner, screen);
+            minScreen = glm::min(minScreen, screen);
+            maxScreen = glm::max(maxScreen, screen);
+        }
+        if (!behind && (maxScreen.x < minOutline.x || minScreen.x > maxOutline.x
+                     || maxScreen.y < minOutline.y || minScreen.y > maxOutline.y)) {
+            continue;
+        }
+
+        glm::ivec3 tileOrigin = tile->location * dimensions;
+        for (size_t i = 0; i < tile->blocks.size(); i++) {
+            if (tile->blocks[i].blockType == Scene::Block::BlockType::EMPTY) {
+                continue;
+            }
+            glm::ivec3 location = tileOrigin + scene->getBlockLocation(i);
+            glm::vec2 screen;
+            if (!project(glm::vec3(location), screen)
+             || screen.x < minOutline.x || screen.x > maxOutline.x
+             || screen.y < minOutline.y || screen.y > maxOutline.y
+             || !inside(screen)) {
+                continue;
+            }
+            // Visible if nothing else is hit on the way to its centre. The
+            // ray may pass through shapes that leave their centre empty.
+            RayPicker::Hit hit;
+            glm::vec3 toBlock = glm::vec3(location) - eye;
+            float distance = glm::length(toBlock);
+            if (!picker->pick(scene, eye, toBlock, distance, hit) 
+             || hit.location == location) {
+                selected.push_back(location);
+            }
+        }
+    }
+    return selected;
+}
+
 void Renderer::gen3DTex() {
     std::vector<float> texels;
 
@@ -342,22 +591,371 @@ void Renderer::gen3DTex() {
 }
 
 void Renderer::renderScene(Scene* scene) {
+    auto start = std::chrono::steady_clock::now();
+    if (sceneTimeQueryPending) {
+        GLint available = 0;
+        glGetQueryObjectiv(sceneTimeQuery, GL_QUERY_RESULT_AVAILABLE, 
+                           &available);
+        if (available) {
+            GLuint64 time;
+            glGetQueryObjectui64v(sceneTimeQuery, GL_QUERY_RESULT, &time);
+            sceneGPUTime = time / 1000000.0f;
+            sceneTimeQueryPending = false;
+        }
+    }
+    // Only one query is in flight, so some frames go unmeasured
+    bool timed = timerQueries && !sceneTimeQueryPending;
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, sceneTimeQuery);
+    }
+
     Entity* camera = scene->getCamera();
     worldToCameraMatrix = lookCamera(camera);
     matrixStack.push(matrixStack.top() * worldToCameraMatrix);
 
     glUseProgram(shaderManager->getEntityShader());
+    glUniform1ui(glGetUniformLocation(
+                     shaderManager->getEntityShader(), "tileIDShift"),
+                 scene->getMaxBytes());
+    glUniform1i(glGetUniformLocation(
+                    shaderManager->getEntityShader(), "radiosity"), radiosity);
 
     setModelToCameraMatrix();
 
+    uploadSelection(scene);
+
+    if (radiosity) {
+        if (lightBaker == nullptr) {
+            lightBaker = new LightBaker(scene->getTileDimensions());
+        }
+        lightBaker->update(scene);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, lightBaker->getTexture());
+    }
+
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_3D, tileTex);
 
+    frameStats = FrameStats();
+    uploadTileModels(scene);
+    glm::mat4 worldToClipMatrix = cameraToClipMatrix * matrixStack.top();
+    cameraLocation = glm::vec3(glm::inverse(worldToCameraMatrix)
+                             * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    Frustum frustum(worldToClipMatrix);
+    scene->setStreamView(worldToClipMatrix);
+
+    scheduleRebuilds(scene, frustum);
+
+    std::vector<Scene::Tile*> visibleTiles;
     for (auto tile : scene->getTiles()) {
-        renderTile(scene, tile->location);
+        glm::vec3 minBound, maxBound;
+        if (!scene->getTileBounds(tile, minBound, maxBound)
+         || !frustum.intersects(minBound, maxBound)) {
+            frameStats.tilesCulled++;
+            continue;
+        }
+        visibleTiles.push_back(tile);
+    }
+
+    if (occlusionCulling) {
+        cullOccludedTiles(scene, visibleTiles, worldToClipMatrix);
+    }
+
+    if (instancedBlocks) {
+        renderTilesInstanced(scene, visibleTiles);
+    } else {
+        queuedDraws.clear();
+        for (auto tile : visibleTiles) {
+            renderTile(scene, tile);
+            frameStats.tilesDrawn++;
+        }
+        submitDraws();
     }
 
     matrixStack.pop();
+
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        sceneTimeQueryPending = true;
+    }
+    std::chrono::duration<float, std::milli> time = 
+        std::chrono::steady_clock::now() - start;
+    frameStats.sceneCPUTime = time.count();
+    frameStats.sceneGPUTime = sceneGPUTime;
+}
+
+void Renderer::renderTilesInstanced(Scene* scene, 
+                                    const std::vector<Scene::Tile*>& tiles) {
+    if (blockInstancer == nullptr) {
+        blockInstancer = new BlockInstancer(getTileMesher(scene));
+    }
+    for (auto tile : tiles) {
+        blockInstancer->addTile(scene, tile, 
+                                scene->getTileID(tile) << scene->getMaxBytes());
+        frameStats.tilesDrawn++;
+    }
+
+    // Shares the entity shader's uniforms and outputs
+    glUseProgram(shaderManager->getBlockInstanceShader());
+    frameStats.drawCalls = blockInstancer->draw();
+    frameStats.blockInstances = blockInstancer->getNumInstances();
+    glUseProgram(shaderManager->getEntityShader());
+}
+
+void Renderer::scheduleRebuilds(Scene* scene, const Frustum& frustum) {
+    // Tiles in view nearest the block last edited go first
+    glm::vec3 cursor(scene->getLastModifiedBlock());
+    glm::vec3 tileDimensions(scene->getTileDimensions());
+    auto priority = [&](glm::ivec3 tileLocation) {
+        Scene::Tile* tile = scene->getTile(tileLocation);
+        glm::vec3 minBound, maxBound;
+        if (tile == nullptr || !scene->getTileBounds(tile, minBound, maxBound)) {
+            return 0.0f; // Removed, which only needs its models released
+        }
+        glm::vec3 centre = (glm::vec3(tileLocation) + 0.5f) * tileDimensions;
+        float distance = glm::length(centre - cursor);
+        return frustum.intersects(minBound, maxBound) 
+             ? distance : distance + outOfViewPriority;
+    };
+    rebuildScheduler->run(priority, [&](glm::ivec3 tileLocation) {
+        rebuildTile(scene, tileLocation);
+    });
+}
+
+void Renderer::uploadSelection(Scene* scene) {
+    tileIDShift = scene->getMaxBytes();
+    if (scene->getSelectionRevision() == selectionRevision) {
+        return;
+    }
+    selectionRevision = scene->getSelectionRevision();
+
+    // 32 bit words, as the shader reads them
+    glm::ivec3 tileDimensions = scene->getTileDimensions();
+    size_t wordsPerTile = 
+        (tileDimensions.x * tileDimensions.y * tileDimensions.z + 31) / 32;
+    std::vector<GLuint> words(scene->getNumTileHandles() * wordsPerTile, 0);
+    selectionVisible = false;
+    for (auto tile : scene->getTiles()) {
+        if (tile->numSelected == 0) {
+            continue;
+        }
+        selectionVisible = true;
+        GLuint* tileWords = &words[tile->handle * wordsPerTile];
+        for (size_t i = 0; i < wordsPerTile; i++) {
+            tileWords[i] = (GLuint)(tile->selected[i / 2] >> (i % 2 * 32));
+        }
+    }
+    if (!selectionVisible) {
+        return;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, selectionBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, words.size() * sizeof(GLuint), 
+                 words.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, selectionTex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, selectionBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::cullOccludedTiles(Scene* scene, 
+                                 std::vector<Scene::Tile*>& tiles,
+                                 const glm::mat4& worldToClipMatrix) {
+    // Largest solid tiles relative to their distance make the best occluders
+    std::vector<std::pair<float, Scene::Tile*>> occluders;
+    for (auto tile : tiles) {
+        if (!scene->isSolidTile(tile)) {
+            continue;
+        }
+        glm::vec3 minBound, maxBound;
+        scene->getTileBounds(tile, minBound, maxBound);
+        glm::vec3 toCenter = (minBound + maxBound) * 0.5f - cameraLocation;
+        float size = glm::length(maxBound - minBound);
+        occluders.push_back(std::make_pair(
+            size * size / std::max(glm::dot(toCenter, toCenter), 1.0f), tile));
+    }
+    if (occluders.empty()) {
+        return;
+    }
+    size_t numOccluders = std::min(occluders.size(), maxOccluders);
+    std::partial_sort(occluders.begin(), occluders.begin() + numOccluders,
+                      occluders.end(), 
+                      [](const std::pair<float, Scene::Tile*>& a,
+                         const std::pair<float, Scene::Tile*>& b) {
+                          return a.first > b.first;
+                      });
+    occluders.resize(numOccluders);
+
+    occlusionBuffer->clear(worldToClipMatrix);
+    for (auto occluder : occluders) {
+        glm::vec3 minBound, maxBound;
+        scene->getTileBounds(occluder.second, minBound, maxBound);
+        occlusionBuffer->addOccluder(minBound, maxBound);
+    }
+
+    auto isOccluder = [&](Scene::Tile* tile) {
+        for (auto occluder : occluders) {
+            if (occluder.second == tile) return true;
+        }
+        return false;
+    };
+
+    size_t numVisible = 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        glm::vec3 minBound, maxBound;
+        scene->getTileBounds(tiles[i], minBound, maxBound);
+        if (!isOccluder(tiles[i]) 
+         && occlusionBuffer->isOccluded(minBound, maxBound)) {
+            frameStats.tilesOccluded++;
+            continue;
+        }
+        tiles[numVisible++] = tiles[i];
+    }
+    tiles.resize(numVisible);
+}
+
+const Renderer::FrameStats& Renderer::getFrameStats() {
+    return frameStats;
+}
+
+const Renderer::MesherStats& Renderer::getMesherStats() {
+    return mesherStats;
+}
+
+void Renderer::printStats() {
+    std::cout << "Tiles drawn: " << frameStats.tilesDrawn
+              << ", culled: " << frameStats.tilesCulled 
+              << ", occluded: " << frameStats.tilesOccluded
+              << (occlusionCulling ? "" : " (occlusion culling off)")
+              << std::endl;
+    std::cout << "Triangles drawn: " << frameStats.trianglesDrawn
+              << ", back facing: " << frameStats.trianglesBackFacing 
+              << std::endl;
+    if (instancedBlocks) {
+        std::cout << "Draw calls: " << frameStats.drawCalls << " for " 
+                  << frameStats.blockInstances << " block instances"
+                  << std::endl;
+    } else {
+        std::cout << "Draw calls: " << frameStats.drawCalls << " for " 
+                  << frameStats.drawRanges << " ranges"
+                  << (multiDrawIndirect ? " (multi-draw indirect)" 
+                                        : " (multi-draw per tile)")
+                  << std::endl;
+    }
+    std::cout << "Scene time: " << frameStats.sceneCPUTime << " ms CPU";
+    if (timerQueries) {
+        std::cout << ", " << frameStats.sceneGPUTime << " ms GPU";
+    }
+    std::cout << (instancedBlocks ? " (instanced blocks)" 
+                                  : " (tile meshes)") << std::endl;
+    if (mesherStats.triangles > 0) {
+        std::cout << "Tiles meshed: " << mesherStats.tilesMeshed
+                  << ", vertices per triangle: " 
+                  << mesherStats.vertices / (double)mesherStats.triangles
+                  << " (per tile min " << mesherStats.minVertexRatio
+                  << ", max " << mesherStats.maxVertexRatio << ")" 
+                  << std::endl;
+    }
+    unsigned long long requests = mesherStats.cacheHits 
+                                + mesherStats.cacheMisses;
+    if (requests > 0) {
+        std::cout << "Mesh cache: " << mesherStats.cacheHits << " hits, "
+                  << mesherStats.cacheMisses << " misses ("
+                  << 100.0 * mesherStats.cacheHits / requests << "% hit rate), "
+                  << meshCache->getNumModels() << " models, "
+                  << meshCache->getNumIdle() << " unused in "
+                  << meshCache->getIdleBytes() / 1024 << " of " 
+                  << meshCache->getCapacity() / 1024 << " KB, "
+                  << meshCache->getNumEvictions() << " evicted, "
+                  << mesherStats.slicesReused << " slices reused" << std::endl;
+    }
+    auto printArena = [](const char* name, BufferArena* arena) {
+        std::cout << name << " buffers: " << arena->getLiveBytes() / 1024
+                  << " KB live in " << arena->getNumAllocations() 
+                  << " slices, " << arena->getCapacity() / 1024 << " KB in "
+                  << arena->getNumPages() << " pages, fragmentation "
+                  << arena->getFragmentation() * 100.0f << "%" << std::endl;
+    };
+    printArena("Vertex", vertexArena);
+    printArena("Index", indexArena);
+    if (blockInstancer != nullptr) {
+        std::cout << "Block instances: " 
+                  << blockInstancer->getGPUBytes() / 1024 << " KB GPU, "
+                  << blockInstancer->getCPUBytes() / 1024 << " KB CPU" 
+                  << std::endl;
+    }
+    std::cout << "Tiles per detail level:";
+    for (int i = 0; i < LodBuilder::NUM_LEVELS; i++) {
+        std::cout << " " << frameStats.tilesPerLevel[i];
+    }
+    std::cout << " (" << meshWorker->getNumJobs() << " building)" << std::endl;
+    if (lightBaker != nullptr) {
+        std::cout << "Light bake: " << lightBaker->getNumBaked() 
+                  << " tiles baked, " << lightBaker->getNumJobs() 
+                  << " baking, " << lightBaker->getCPUBytes() / 1024 
+                  << " KB kept" << (radiosity ? "" : " (radiosity off)") 
+                  << std::endl;
+    }
+    if (rayPicker != nullptr) {
+        const RayPicker::Stats& picks = rayPicker->getStats();
+        std::cout << "Picking: " << picks.picks << " rays, " 
+                  << (picks.picks > 0 ? picks.totalTime / picks.picks : 0.0)
+                  << " us average, " << picks.maxTime << " us max, "
+                  << (picks.picks > 0 
+                      ? picks.blocksVisited / (double)picks.picks : 0.0)
+                  << " blocks visited per ray"
+                  << (cpuPicking ? "" : " (reading colour IDs)") << std::endl;
+    }
+    const RebuildScheduler::Stats& rebuilds = rebuildScheduler->getStats();
+    std::cout << "Rebuild queue: " << rebuildScheduler->getQueueDepth() 
+              << " tiles, " << rebuildScheduler->getNumStarted() 
+              << " meshing, " << rebuilds.rebuiltLastFrame << " started in "
+              << rebuilds.lastFrameTime << " of " 
+              << rebuildScheduler->getBudget() 
+              << " ms last frame (snapshot and dispatch), latency to upload "
+              << rebuilds.averageLatency << " ms average, " 
+              << rebuilds.maxLatency << " ms max" << std::endl;
+}
+
+void Renderer::benchmarkMeshing(Scene* scene) {
+    const int numPasses = 3;
+
+    getTileMesher(scene);
+    if (meshWorker->getNumJobs() > 0) {
+        std::cout << "Note: the worker pool is busy, and its allocations are "
+                  << "counted too" << std::endl;
+    }
+
+    std::vector<Scene::TileSnapshot> snapshots;
+    for (auto tile : scene->getTiles()) {
+        snapshots.push_back(scene->getTileSnapshot(tile));
+    }
+    std::vector<std::pair<size_t, size_t>> sizeHints(snapshots.size());
+
+    // The first pass starts from an empty scratch, as a new thread would
+    MeshScratch scratch;
+    for (int pass = 0; pass < numPasses; pass++) {
+        unsigned long long allocations = AllocationCounter::allocations;
+        unsigned long long bytes = AllocationCounter::bytes;
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            TileMesh* tileMesh = tileMesher->build(snapshots[i], scratch, 
+                                                   sizeHints[i].first, 
+                                                   sizeHints[i].second);
+            sizeHints[i] = std::make_pair(tileMesh->vertices.size(), 
+                                          tileMesh->indices.size());
+            TileMesh::release(tileMesh);
+        }
+
+        std::chrono::duration<double, std::milli> time = 
+            std::chrono::steady_clock::now() - start;
+        std::cout << "Meshing pass " << pass + 1 << ": " << snapshots.size()
+                  << " tiles in " << time.count() << " ms, "
+                  << AllocationCounter::allocations - allocations 
+                  << " allocations ("
+                  << AllocationCounter::bytes - bytes << " bytes)" 
+                  << std::endl;
+    }
 }
 
 Mesh* Renderer::getBlockType(Scene::Block::BlockType blockType,
@@ -418,264 +1016,155 @@ Mesh* Renderer::getBlockType(Scene::Block::BlockType blockType,
     return mesh;
 }
 
-void Renderer::buildModel(const std::vector<float>& vertices,
-                          const std::vector<float>& normals,
-                          const std::vector<GLuint>& indices,
-                          const std::vector<float>& colourIDs,
-                          const std::vector<float>& uvw,
-                          Scene::Tile* tile) {
-    GLuint vertexArrayID;
-    GLuint vertexBufferID;
-    GLuint normalBufferID;
-    GLuint colourIDBuffer;
-    GLuint indexBufferID;
-    GLuint uvwBufferID;
-
-    // Create VAO
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
-
-    // Create vertex buffer
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(),
-                 &vertices[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Create normal buffer
-    glGenBuffers(1, &normalBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), 
-                 &normals[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Create colour ID buffer
-    glGenBuffers(1, &colourIDBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, colourIDBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(colourIDs[0]) * colourIDs.size(),
-                 &colourIDs[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Create uvw buffer
-    glGenBuffers(1, &uvwBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, uvwBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(uvw[0]) * uvw.size(),
-                 &uvw[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Create index buffer
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(),
-                 &indices[0], GL_STATIC_DRAW);
+void Renderer::uploadModel(const TileMesh& tileMesh, ModelInfo* modelInfo) {
+    const ScratchVector<TileVertex>& vertices = tileMesh.vertices;
+    const ScratchVector<unsigned int>& indices = tileMesh.indices;
+
+    // 16-bit indices whenever they suffice
+    GLenum indexType = GL_UNSIGNED_INT;
+    const void* indexData = &indices[0];
+    size_t indexBytes = sizeof(indices[0]) * indices.size();
+    std::vector<GLushort> shortIndices;
+    if (vertices.size() <= 0xFFFF) {
+        shortIndices.assign(indices.begin(), indices.end());
+        indexType = GL_UNSIGNED_SHORT;
+        indexData = &shortIndices[0];
+        indexBytes = sizeof(shortIndices[0]) * shortIndices.size();
+    }
+    size_t vertexBytes = sizeof(vertices[0]) * vertices.size();
+
+    // Slices of a spare model (see takeSpareModel) are reused in place when
+    // the new mesh fits and does not leave most of the slice unused
+    auto reserve = [this](BufferArena* arena, 
+                          BufferArena::Allocation& allocation, size_t size) {
+        if (allocation.page != -1 
+         && size <= allocation.size && size * 2 >= allocation.size) {
+            mesherStats.slicesReused++;
+            return;
+        }
+        arena->free(allocation);
+        allocation = arena->allocate(size);
+    };
+    reserve(vertexArena, modelInfo->vertexAllocation, vertexBytes);
+    reserve(indexArena, modelInfo->indexAllocation, indexBytes);
 
-    glBindVertexArray(0);
+    vertexArena->upload(modelInfo->vertexAllocation, &vertices[0], vertexBytes);
+    indexArena->upload(modelInfo->indexAllocation, indexData, indexBytes);
 
-    ModelInfo* modelInfo = new ModelInfo();
+    float vertexRatio = vertices.size() / (float)tileMesh.getNumTriangles();
+    if (mesherStats.tilesMeshed == 0) {
+        mesherStats.minVertexRatio = vertexRatio;
+        mesherStats.maxVertexRatio = vertexRatio;
+    } else {
+        mesherStats.minVertexRatio = std::min(mesherStats.minVertexRatio, 
+                                              vertexRatio);
+        mesherStats.maxVertexRatio = std::max(mesherStats.maxVertexRatio, 
+                                              vertexRatio);
+    }
+    mesherStats.tilesMeshed++;
+    mesherStats.vertices += vertices.size();
+    mesherStats.triangles += tileMesh.getNumTriangles();
 
-    modelInfo->vertexArrayObject = vertexArrayID;
-    modelInfo->vertexBufferObject = vertexBufferID;
-    modelInfo->normalBufferObject = normalBufferID;
-    modelInfo->indexBufferObject = indexBufferID;
-    modelInfo->colourIDBufferObject = colourIDBuffer;
-    modelInfo->uvwBufferObject = uvwBufferID;
     modelInfo->numIndices = indices.size();
+    modelInfo->numVertices = vertices.size();
+    modelInfo->indexType = indexType;
 
-    std::stringstream ss;
-
-    ss << "tile " << tile->location.x 
-       << " " << tile->location.y
-       << " " << tile->location.z;
-
-    models[ss.str()] = modelInfo;
+    for (int i = 0; i < TileMesh::NUM_BUCKETS; i++) {
+        modelInfo->bucketStart[i] = tileMesh.bucketStart[i];
+        modelInfo->bucketCount[i] = tileMesh.bucketCount[i];
+    }
 }
 
-glm::vec3 Renderer::getTileColourID(glm::vec3 normal, int index,
-                                    Scene* scene, Scene::Tile* tile) {
-    unsigned int faceID = 0;
-
-    if (normal.x < 0.0f) {
-        faceID = 1;
-    } else if (normal.y < 0.0f) {
-        faceID = 2;
-    } else if (normal.z < 0.0f) {
-        faceID = 3;
-    } else if (normal.y > 0.0f) {
-        faceID = 4;
-    } else if (normal.z > 0.0f) {
-        faceID = 5;
+void Renderer::deleteModel(ModelInfo* modelInfo) {
+    if (modelInfo->vertexAllocation.page != -1 
+     && spareModels.size() < maxSpareModels) {
+        spareModels.push_back(modelInfo);
+        return;
     }
-
-    unsigned int colourID = index * 6 + 1 + faceID;
-
-    unsigned int blockR = ((colourID >> 16) & 0xFF);
-    unsigned int blockG = ((colourID >> 8 ) & 0xFF);
-    unsigned int blockB = ((colourID >> 0 ) & 0xFF);
-
-    unsigned int tileColourID = scene->getTileID(tile);
-
-    tileColourID = tileColourID << scene->getMaxBytes();
-
-    unsigned int tileR = ((tileColourID >> 16) & 0xFF);
-    unsigned int tileG = ((tileColourID >> 8 ) & 0xFF);
-    unsigned int tileB = ((tileColourID >> 0 ) & 0xFF);
-
-    float colourR = (blockR | tileR);
-    float colourG = (blockG | tileG);
-    float colourB = (blockB | tileB);
-
-    colourR = (blockR | tileR) / 255.0f;
-    colourG = (blockG | tileG) / 255.0f;
-    colourB = (blockB | tileB) / 255.0f;
-
-    return glm::vec3(colourR, colourG, colourB);
+    vertexArena->free(modelInfo->vertexAllocation);
+    indexArena->free(modelInfo->indexAllocation);
+    delete modelInfo;
 }
 
-void Renderer::buildTileVBO(Scene* scene, glm::ivec3 tileLocation) {
-    auto tile = scene->getTile(tileLocation);
-    if (tile == nullptr) return;
-
-    std::vector<float> vertices;
-    std::vector<float> normals;
-    std::vector<GLuint> indices;
-    std::vector<float> colourIDs;
-    std::vector<float> uvw;
-
-    size_t indexCount = 0;
-    for (size_t i = 0; i < tile->blocks.size(); i++) {
-        glm::ivec3 blockLocation = scene->getBlockLocation(i);
-
-        glm::ivec3 location = tileLocation * scene->getTileDimensions()
-                            + blockLocation;
-
-        Scene::Block& block = scene->getBlock(location);
-
-        Mesh* mesh = getBlockType(block.blockType, block.rotation);
-        if (mesh == nullptr) {
-            continue;
+GLuint Renderer::getPageVertexArray(int page) {
+    // Every page holds the same vertex format, so one VAO serves all of the
+    // tiles within it
+    while ((int)pageVertexArrays.size() <= page) {
+        GLuint vertexArrayID;
+        glGenVertexArrays(1, &vertexArrayID);
+        glBindVertexArray(vertexArrayID);
+        glBindBuffer(GL_ARRAY_BUFFER, 
+                     vertexArena->getBuffer(pageVertexArrays.size()));
+
+        GLsizei stride = sizeof(TileVertex);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+                              (void*)offsetof(TileVertex, position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, stride, 
+                               (void*)offsetof(TileVertex, normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, stride, 
+                               (void*)offsetof(TileVertex, colourID));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, stride, 
+                               (void*)offsetof(TileVertex, block));
+
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 1, GL_UNSIGNED_BYTE, GL_TRUE, stride, 
+                              (void*)offsetof(TileVertex, ambient));
+
+        // Otherwise the tile data is set as a constant attribute per tile
+        if (multiDrawIndirect) {
+            glBindBuffer(GL_ARRAY_BUFFER, drawTileDataBuffer);
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 0, 0);
+            glVertexAttribDivisor(4, 1);
         }
 
-        std::vector<glm::vec3> faceNormals;
-
-        auto pushVertex = [&](glm::vec3 vertex) {
-            vertices.push_back(vertex.x + location.x);
-            vertices.push_back(vertex.y + location.y);
-            vertices.push_back(vertex.z + location.z);
-        };
-        auto pushNormal = [&](glm::vec3 normal) {
-            normals.push_back(normal.x);
-            normals.push_back(normal.y);
-            normals.push_back(normal.z);
-        };
-        auto pushColourID = [&](glm::vec3 colourID) {
-            colourIDs.push_back(colourID.x);
-            colourIDs.push_back(colourID.y);
-            colourIDs.push_back(colourID.z);
-        };
-        auto pushUvw = [&](glm::vec3 location) {
-            uvw.push_back((location.x + blockLocation.x + 0.5f)
-                / scene->getTileDimensions().x);
-            uvw.push_back((location.y + blockLocation.y + 0.5f)
-                / scene->getTileDimensions().y);
-            uvw.push_back((location.z + blockLocation.z + 0.5f)
-                / scene->getTileDimensions().z);
-        };
-        auto addTriangle = [&](size_t v1, size_t v2, size_t v3) {
-            pushVertex(mesh->vertices[v1]);
-            pushVertex(mesh->vertices[v2]);
-            pushVertex(mesh->vertices[v3]);
-
-            pushNormal(mesh->normals[v1]);
-            pushNormal(mesh->normals[v2]);
-            pushNormal(mesh->normals[v3]);
-
-            indices.push_back(indexCount + 0);
-            indices.push_back(indexCount + 1);
-            indices.push_back(indexCount + 2);
-
-            indexCount += 3;
-
-            glm::vec3 colourID = 
-                        getTileColourID(mesh->normals[v1], 
-                                        i, scene, tile);
-
-            pushColourID(colourID);
-            pushColourID(colourID);
-            pushColourID(colourID);
-
-            glm::vec3 averageVert = (mesh->vertices[v1]
-                                   + mesh->vertices[v2]
-                                   + mesh->vertices[v3]) / 3.0f;
-
-            pushUvw(averageVert);
-            pushUvw(averageVert);
-            pushUvw(averageVert);
-        };
+        glBindVertexArray(0);
+        pageVertexArrays.push_back(vertexArrayID);
+    }
+    return pageVertexArrays[page];
+}
 
-        for (size_t j = 0; j <= mesh->normals.size(); j++) {
-            if (!(faceNormals.size() == 0 
-               || faceNormals[0] == mesh->normals[j])) {
-
-                int visibility = 
-                    scene->checkVisibility(location, mesh->normals[j - 1]);
-                size_t faceSize = faceNormals.size();
-                faceNormals.clear();
-                if (faceSize == 3) {
-                    int ownVisibility = 
-                        scene->checkVisibilityDirection(location, 
-                                                        mesh->normals[j - 1]);
-                    int criteria = 1;
-                    if (mesh->normals[j - 1].y != 0) criteria = 0;  
-                    if (abs(visibility + ownVisibility) != criteria 
-                     && ownVisibility != -1)
-                        addTriangle(j-3, j-2, j-1);
-                } else {
-                    switch (visibility) {
-                    case 1: {
-                        addTriangle(j-4, j-3, j-2);
-                        addTriangle(j-4, j-2, j-1);
-                        break;
-                    }
-                    case Scene::SE: {
-                        addTriangle(j-4, j-2, j-1);
-                        break;
-                    } 
-                    case Scene::SW: {
-                        addTriangle(j-1, j-4, j-3);
-                        break;
-                    }
-                    case Scene::NE: {
-                        addTriangle(j-3, j-2, j-1);
-                        break;
-                    }
-                    case Scene::NW: {
-                        addTriangle(j-4, j-3, j-2);
-                        break;
-                    }
-                    default:
-                        break;
-                    }
-                }
-            }
-            if (j < mesh->normals.size())
-                faceNormals.push_back(mesh->normals[j]);
-        }
+Renderer::TileModels& Renderer::getTileModels(Scene::Tile* tile) {
+    if (tile->handle >= tileModels.size()) {
+        tileModels.resize(tile->handle + 1);
+        tileModels[tile->handle].location = tile->location;
+    }
+    TileModels& models = tileModels[tile->handle];
+    if (models.location != tile->location) {
+        // The handle belonged to a removed tile
+        clearTileModels(models);
+        models.location = tile->location;
+        models.lastLevel = 0;
     }
+    return models;
+}
 
-    if (vertices.size() == 0) {
-        std::cout << "No vertices" << std::endl;
-        return;
+void Renderer::clearTileModels(TileModels& models) {
+    for (int level = 0; level < LodBuilder::NUM_LEVELS; level++) {
+        setTileModel(models, level, nullptr, 0);
     }
+}
 
-    buildModel(vertices, normals, indices, colourIDs, uvw, tile);
+void Renderer::setTileModel(TileModels& models, int level, ModelInfo* model,
+                            unsigned int revision) {
+    // The caller hands over its reference to the new model
+    ModelInfo* oldModel = models.levels[level];
+    if (oldModel != nullptr) {
+        meshCache->release(oldModel->cacheKey, oldModel);
+    }
+    models.levels[level] = model;
+    models.revisions[level] = revision;
+    if (level == 0 && model != nullptr) {
+        rebuildScheduler->finished(models.location);
+    }
 }
 
 void Renderer::removeText(std::wstring text) {
@@ -685,16 +1174,21 @@ void Renderer::removeText(std::wstring text) {
 void Renderer::rebuildTile(Scene* scene, glm::ivec3 tileLocation) {
     auto tile = scene->getTile(tileLocation);
     if (tile != nullptr) {
-        std::stringstream ss;
-    
-        auto modelIt = models.find(ss.str());
-        if (modelIt != models.end()) {
-            delete modelIt->second;
-            models.erase(modelIt);
-        }
-        buildTileVBO(scene, tileLocation);
+        // The current model is drawn until its replacement is built. Reduced
+        // detail models are rebuilt lazily once found to be stale.
+        requestTileModel(scene, tile, 0);
     } else {
-        std::cout << "Tile is null" << std::endl;
+        // The tile was removed along with its last block. Unless its handle
+        // has been reused already, its models are still in its slot.
+        for (auto& models : tileModels) {
+            if (models.location == tileLocation) {
+                clearTileModels(models);
+            }
+        }
+        if (blockInstancer != nullptr) {
+            blockInstancer->removeTile(tileLocation);
+        }
+        rebuildScheduler->finished(tileLocation);
     }
 }
 
@@ -727,6 +1221,7 @@ void Renderer::loadMesh(const std::string& modelDirectory,
         for (unsigned int index : mesh->indices) {
             rotatedMesh->indices.push_back(index);
         }
+        rotatedMesh->buildFaces();
         rotatedMeshes.push_back(rotatedMesh);
     }
     meshes.insert(make_pair(meshName, rotatedMeshes));
@@ -741,6 +1236,8 @@ void Renderer::exportScene(Scene* scene) {
     std::vector<glm::vec3> normals;
     std::vector<glm::ivec3> indices;
 
+    scene->streamAllTiles();
+
     size_t indexCount = 0;
     for (auto tile : scene->tiles) {
         glm::ivec3 tileLocation = tile->location;
@@ -748,15 +1245,13 @@ void Renderer::exportScene(Scene* scene) {
             glm::ivec3 location = tileLocation * scene->getTileDimensions()
                                 + scene->getBlockLocation(i);
 
-            Scene::Block& block = scene->getBlock(location);
+            Scene::Block block = scene->getBlock(location);
 
             Mesh* mesh = getBlockType(block.blockType, block.rotation);
             if (mesh == nullptr) {
                 continue;
             }
 
-            std::vector<glm::vec3> faceNormals;
-
             auto pushVertex = [&](glm::vec3 vertex) {
                 vertices.push_back(vertex + glm::vec3(location));
             };
@@ -782,53 +1277,18 @@ void Renderer::exportScene(Scene* scene) {
                 indexCount += 3;
             };
 
-            for (size_t j = 0; j <= mesh->normals.size(); j++) {
-                if (!(faceNormals.size() == 0 
-                   || faceNormals[0] == mesh->normals[j])) {
-
-                    int visibility = 
-                        scene->checkVisibility(location, mesh->normals[j - 1]);
-                    size_t faceSize = faceNormals.size();
-                    faceNormals.clear();
-                    if (faceSize == 3) {
-                        int ownVisibility = 
-                            scene->checkVisibilityDirection(location, 
-                                                            mesh->normals[j - 1]);
-                        int criteria = 1;
-                        if (mesh->normals[j - 1].y != 0) criteria = 0;  
-                        if (abs(visibility + ownVisibility) != criteria 
-                         && ownVisibility != -1)
-                            addTriangle(j-3, j-2, j-1);
-                    } else {
-                        switch (visibility) {
-                        case 1: {
-                            addTriangle(j-4, j-3, j-2);
-                            addTriangle(j-4, j-2, j-1);
-                            break;
-                        }
-                        case Scene::SE: {
-                            addTriangle(j-4, j-2, j-1);
-                            break;
-                        } 
-                        case Scene::SW: {
-                            addTriangle(j-1, j-4, j-3);
-                            break;
-                        }
-                        case Scene::NE: {
-                            addTriangle(j-3, j-2, j-1);
-                            break;
-                        }
-                        case Scene::NW: {
-                            addTriangle(j-4, j-3, j-2);
-                            break;
-                        }
-                        default:
-                            break;
-                        }
-                    }
+            for (const Mesh::Face& face : mesh->faces) {
+                int visibility = scene->checkVisibility(location, face.normal);
+                int ownVisibility = face.triangle 
+                    ? scene->checkVisibilityDirection(location, face.normal) 
+                    : 0;
+                Mesh::FaceVariant variant = face.getVariant(visibility, 
+                                                            ownVisibility);
+                for (int t = 0; t < face.numTriangles[variant]; t++) {
+                    addTriangle(face.triangles[variant][t][0], 
+                                face.triangles[variant][t][1],
+                                face.triangles[variant][t][2]);
                 }
-                if (j < mesh->normals.size())
-                    faceNormals.push_back(mesh->normals[j]);
             }
         }
     }
@@ -876,33 +1336,404 @@ void Renderer::exportScene(Scene* scene) {
         baseMesh.vertices.push_back(vert.second);
     }
 
-    scene->save("tile.sav");
-
     TriMesh* trimesh = new TriMesh(baseMesh);
     trimesh->decimate();
     trimesh->writeObj();
     delete trimesh;
 }
 
-void Renderer::renderTile(Scene* scene, glm::ivec3 tileLocation) {
-    auto tile = scene->getTile(tileLocation);
-    if (tile != nullptr) {
-        std::stringstream ss;
+void Renderer::renderTile(Scene* scene, Scene::Tile* tile) {
+    glm::vec3 minBound, maxBound;
+    scene->getTileBounds(tile, minBound, maxBound);
+    // The handle is shifted into place in the shader, as floats only hold
+    // integers up to 2^24 exactly
+    glm::vec4 tileData(glm::vec3(tile->location * scene->getTileDimensions()),
+                       scene->getTileID(tile));
+
+    int level = selectLevel(tile, minBound, maxBound);
+    ModelInfo* model = getTileModel(scene, tile, level);
+    if (level > 0 && (model == nullptr || model->numIndices == 0)) {
+        // Full detail stands in while the reduced model is being built,
+        // but only if it happens to exist already
+        model = getTileModels(tile).levels[0];
+        level = 0;
+    }
+    if (model == nullptr || model->numIndices == 0) {
+        return;
+    }
 
-        ss << "tile " << tile->location.x 
-           << " " << tile->location.y
-           << " " << tile->location.z;
+    frameStats.tilesPerLevel[level]++;
+    queueModel(model, tileData, minBound, maxBound);
+}
+
+void Renderer::queueModel(ModelInfo* model, glm::vec4 tileData, 
+                          glm::vec3 minBound, glm::vec3 maxBound) {
+    size_t indexSize = model->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort)
+                                                             : sizeof(GLuint);
+    QueuedDraw draw;
+    draw.vertexPage = model->vertexAllocation.page;
+    draw.indexPage = model->indexAllocation.page;
+    draw.indexType = model->indexType;
+    draw.tileData = tileData;
+    draw.command.instanceCount = 1;
+    draw.command.baseVertex = model->vertexAllocation.offset 
+                            / sizeof(TileVertex);
+    draw.command.baseInstance = 0;
+    GLuint firstIndex = model->indexAllocation.offset / indexSize;
+
+    auto queueRange = [&](unsigned int start, unsigned int count) {
+        draw.command.firstIndex = firstIndex + start;
+        draw.command.count = count;
+        queuedDraws.push_back(draw);
+    };
 
-        auto modelIt = models.find(ss.str());
-        if (modelIt == models.end()) {
-            buildTileVBO(scene, tileLocation);
-            modelIt = models.find(ss.str());
+    // Consecutive front facing buckets are merged into a single range
+    unsigned int rangeStart = 0;
+    unsigned int rangeCount = 0;
+    for (int i = 0; i < TileMesh::NUM_BUCKETS; i++) {
+        if (model->bucketCount[i] == 0) {
+            continue;
         }
+        if (!wireframe && isBucketBackFacing(i, minBound, maxBound)) {
+            frameStats.trianglesBackFacing += model->bucketCount[i] / 3;
+            if (rangeCount > 0) {
+                queueRange(rangeStart, rangeCount);
+                rangeCount = 0;
+            }
+            continue;
+        }
+        if (rangeCount == 0) {
+            rangeStart = model->bucketStart[i];
+        }
+        rangeCount = model->bucketStart[i] + model->bucketCount[i] 
+                   - rangeStart;
+        frameStats.trianglesDrawn += model->bucketCount[i] / 3;
+    }
+    if (rangeCount > 0) {
+        queueRange(rangeStart, rangeCount);
+    }
+}
+
+void Renderer::submitDraws() {
+    frameStats.drawRanges = queuedDraws.size();
+    if (queuedDraws.empty()) {
+        return;
+    }
+    if (multiDrawIndirect) {
+        submitDrawsIndirect();
+    } else {
+        submitDrawsPerTile();
+    }
+    glBindVertexArray(0);
+}
+
+void Renderer::submitDrawsIndirect() {
+    auto batchKey = [](const QueuedDraw& draw) {
+        return std::make_tuple(draw.vertexPage, draw.indexPage, draw.indexType);
+    };
+    std::stable_sort(queuedDraws.begin(), queuedDraws.end(), 
+                     [&](const QueuedDraw& a, const QueuedDraw& b) {
+                         return batchKey(a) < batchKey(b);
+                     });
+
+    drawCommands.clear();
+    drawTileData.clear();
+    for (auto& draw : queuedDraws) {
+        draw.command.baseInstance = drawTileData.size();
+        drawCommands.push_back(draw.command);
+        drawTileData.push_back(draw.tileData);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, drawTileDataBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(drawTileData[0]) * drawTileData.size(),
+                 &drawTileData[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, 
+                 sizeof(drawCommands[0]) * drawCommands.size(),
+                 &drawCommands[0], GL_STREAM_DRAW);
+
+    size_t batchStart = 0;
+    for (size_t i = 1; i <= queuedDraws.size(); i++) {
+        if (i < queuedDraws.size() 
+         && batchKey(queuedDraws[i]) == batchKey(queuedDraws[batchStart])) {
+            continue;
+        }
+        const QueuedDraw& draw = queuedDraws[batchStart];
+        glBindVertexArray(getPageVertexArray(draw.vertexPage));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 
+                     indexArena->getBuffer(draw.indexPage));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, draw.indexType, 
+            (void*)(batchStart * sizeof(DrawCommand)), i - batchStart, 0);
+        frameStats.drawCalls++;
+        batchStart = i;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Renderer::submitDrawsPerTile() {
+    // A tile never has more ranges than buckets
+    GLsizei counts[TileMesh::NUM_BUCKETS];
+    const void* offsets[TileMesh::NUM_BUCKETS];
+    GLint baseVertices[TileMesh::NUM_BUCKETS];
+
+    int vertexPage = -1;
+    int indexPage = -1;
+    size_t i = 0;
+    while (i < queuedDraws.size()) {
+        const QueuedDraw& draw = queuedDraws[i];
+        if (draw.vertexPage != vertexPage) {
+            vertexPage = draw.vertexPage;
+            glBindVertexArray(getPageVertexArray(vertexPage));
+            indexPage = -1;
+        }
+        if (draw.indexPage != indexPage) {
+            indexPage = draw.indexPage;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 
+                         indexArena->getBuffer(indexPage));
+        }
+        size_t indexSize = draw.indexType == GL_UNSIGNED_SHORT 
+                         ? sizeof(GLushort) : sizeof(GLuint);
+
+        // The ranges of a tile are queued one after another
+        int numRanges = 0;
+        while (i < queuedDraws.size() && numRanges < TileMesh::NUM_BUCKETS
+            && queuedDraws[i].tileData == draw.tileData
+            && queuedDraws[i].vertexPage == draw.vertexPage) {
+            const DrawCommand& command = queuedDraws[i].command;
+            counts[numRanges] = command.count;
+            offsets[numRanges] = (void*)(command.firstIndex * indexSize);
+            baseVertices[numRanges] = command.baseVertex;
+            numRanges++;
+            i++;
+        }
+
+        glVertexAttrib4f(4, draw.tileData.x, draw.tileData.y, 
+                         draw.tileData.z, draw.tileData.w);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, draw.indexType, 
+                                      offsets, numRanges, baseVertices);
+        frameStats.drawCalls++;
+    }
+}
+
+int Renderer::selectLevel(Scene::Tile* tile, glm::vec3 minBound, 
+                          glm::vec3 maxBound) {
+    // Projected diameter of the tile's bounding sphere, in pixels
+    float radius = glm::length(maxBound - minBound) * 0.5f;
+    float distance = glm::length((minBound + maxBound) * 0.5f - cameraLocation);
+    float size = screenDimensions.y;
+    if (distance > radius) {
+        size = radius * fFrustumScale * screenDimensions.y / distance;
+    }
+
+    TileModels& models = getTileModels(tile);
+    int level = models.lastLevel;
+
+    while (level < LodBuilder::NUM_LEVELS - 1
+        && size < lodThresholds[level] * (1.0f - lodHysteresis)) {
+        level++;
+    }
+    while (level > 0 && size > lodThresholds[level - 1] * (1.0f + lodHysteresis)) {
+        level--;
+    }
+
+    models.lastLevel = level;
+    return level;
+}
+
+Renderer::ModelInfo* Renderer::getTileModel(Scene* scene, Scene::Tile* tile,
+                                            int level) {
+    TileModels& models = getTileModels(tile);
+    ModelInfo* model = models.levels[level];
+    if (model != nullptr && models.revisions[level] == tile->revision) {
+        return model;
+    }
+
+    // Stale full detail models are drawn until rebuildTile replaces them, 
+    // so that edits in view stay within the rebuild budget. Missing models,
+    // and reduced detail ones which are only rebuilt here, are requested.
+    if (model == nullptr || level > 0) {
+        requestTileModel(scene, tile, level);
+    }
+    return model;
+}
+
+RayPicker* Renderer::getRayPicker(Scene* scene) {
+    if (rayPicker == nullptr) {
+        rayPicker = new RayPicker(getTileMesher(scene));
+    }
+    return rayPicker;
+}
+
+glm::vec2 Renderer::getViewportDimensions() {
+    return glm::vec2(deferredArea.z - deferredArea.x, 
+                     deferredArea.w - deferredArea.y);
+}
+
+TileMesher* Renderer::getTileMesher(Scene* scene) {
+    if (tileMesher == nullptr) {
+        tileMesher = new TileMesher(meshes, scene->getBlockVisibilities());
+    }
+    return tileMesher;
+}
+
+void Renderer::requestTileModel(Scene* scene, Scene::Tile* tile, int level) {
+    TileModels& models = getTileModels(tile);
+    if (models.pending[level]) {
+        return;
+    }
+
+    getTileMesher(scene);
+
+    // Full detail also depends on the blocks bordering the tile, reduced 
+    // detail only on the tile's own
+    std::shared_ptr<Scene::TileSnapshot> snapshot;
+    if (level == 0) {
+        snapshot = std::make_shared<Scene::TileSnapshot>(
+            scene->getTileSnapshot(tile));
+    }
+    const std::vector<Scene::Block>& content = 
+        level == 0 ? snapshot->blocks : tile->blocks;
+    ContentKey key = ContentKey::fromBlocks(content, level);
+
+    ModelInfo* model = meshCache->acquire(key, content);
+    if (model != nullptr) {
+        mesherStats.cacheHits++;
+        setTileModel(models, level, model, tile->revision);
+        return;
+    }
+
+    auto pendingIt = pendingContent.find(key);
+    if (pendingIt != pendingContent.end()) {
+        // Shares the build already under way. On a hash collision the tile
+        // tries again once that build is done.
+        if (MeshCache<ModelInfo>::isSameContent(pendingIt->second.blocks, 
+                                                content)) {
+            mesherStats.cacheHits++;
+            pendingIt->second.tiles.push_back(
+                std::make_pair(tile->handle, tile->revision));
+            models.pending[level] = true;
+        }
+        return;
+    }
+
+    mesherStats.cacheMisses++;
+    models.pending[level] = true;
+    PendingContent& pending = pendingContent[key];
+    pending.blocks = content;
+    pending.tiles.push_back(std::make_pair(tile->handle, tile->revision));
+
+    // The previous model's size is a good guess for the new one
+    size_t vertexHint = 0;
+    size_t indexHint = 0;
+    if (models.levels[level] != nullptr) {
+        vertexHint = models.levels[level]->numVertices;
+        indexHint = models.levels[level]->numIndices;
+    }
+
+    MeshWorker::Job job;
+    job.tileHandle = tile->handle;
+    job.revision = tile->revision;
+    job.level = level;
+    job.contentHash = key.hash;
+    if (level == 0) {
+        const TileMesher* mesher = tileMesher;
+        job.build = [=](MeshScratch& scratch) {
+            return mesher->build(*snapshot, scratch, vertexHint, indexHint);
+        };
+    } else {
+        std::vector<Scene::Block> blocks = tile->blocks;
+        glm::ivec3 tileDimensions = scene->getTileDimensions();
+        job.build = [=](MeshScratch& scratch) {
+            return LodBuilder::build(blocks, tileDimensions, level, scratch);
+        };
+    }
+    meshWorker->addJob(job);
+}
+
+void Renderer::uploadTileModels(Scene* scene) {
+    for (auto result : meshWorker->takeResults()) {
+        ContentKey key;
+        key.hash = result.contentHash;
+        key.level = result.level;
+        auto pendingIt = pendingContent.find(key);
+        PendingContent pending = std::move(pendingIt->second);
+        pendingContent.erase(pendingIt);
+
+        // Tiles removed or modified since are left out; they are requested 
+        // again if still needed. Revisions are never repeated, so a reused 
+        // handle cannot match.
+        std::vector<Scene::Tile*> tiles;
+        std::vector<Scene::Tile*> staleTiles;
+        for (auto& waiting : pending.tiles) {
+            if (waiting.first < tileModels.size()) {
+                tileModels[waiting.first].pending[key.level] = false;
+            }
+            auto tile = scene->getTileFromHandle(waiting.first);
+            if (tile != nullptr && tile->revision == waiting.second) {
+                tiles.push_back(tile);
+            } else if (tile != nullptr) {
+                staleTiles.push_back(tile);
+            } else if (key.level == 0 && waiting.first < tileModels.size()) {
+                rebuildScheduler->finished(tileModels[waiting.first].location);
+            }
+        }
+
+        // Cached even if no tile wants it any more, as the content may come
+        // back. Empty models are kept too, so that they are not requested 
+        // again.
+        ModelInfo* model = nullptr;
+        if (!result.tileMesh->indices.empty()) {
+            model = takeSpareModel(*result.tileMesh);
+            uploadModel(*result.tileMesh, model);
+        } else {
+            model = new ModelInfo();
+        }
+        model->cacheKey = key;
+        TileMesh::release(result.tileMesh);
+        meshCache->insert(key, std::move(pending.blocks), model, tiles.size(),
+                          model->vertexAllocation.size 
+                        + model->indexAllocation.size);
+
+        for (auto tile : tiles) {
+            setTileModel(getTileModels(tile), key.level, model, tile->revision);
+        }
+        // Their rebuilds found this build pending and waited for it, and 
+        // stale full detail models are not requested again by getTileModel.
+        // Reduced detail ones are.
+        if (key.level == 0) {
+            for (auto tile : staleTiles) {
+                requestTileModel(scene, tile, 0);
+            }
+        }
+    }
+}
+
+Renderer::ModelInfo* Renderer::takeSpareModel(const TileMesh& tileMesh) {
+    // The first whose vertex slice uploadModel can reuse in place
+    size_t vertexBytes = sizeof(TileVertex) * tileMesh.vertices.size();
+    for (size_t i = 0; i < spareModels.size(); i++) {
+        size_t size = spareModels[i]->vertexAllocation.size;
+        if (vertexBytes <= size && vertexBytes * 2 >= size) {
+            ModelInfo* model = spareModels[i];
+            spareModels[i] = spareModels.back();
+            spareModels.pop_back();
+            return model;
+        }
+    }
+    return new ModelInfo();
+}
 
-        ModelInfo* model = modelIt->second;
-        glBindVertexArray(model->vertexArrayObject);
-        glDrawElements(GL_TRIANGLES, model->numIndices, GL_UNSIGNED_INT, 0);
+bool Renderer::isBucketBackFacing(int bucket, glm::vec3 minBound, 
+                                  glm::vec3 maxBound) {
+    // Every face in the bucket faces away if the camera is behind the tile 
+    // along each axis the bucket's normals point along
+    glm::ivec3 direction = TileMesh::getBucketDirection(bucket);
+    for (int i = 0; i < 3; i++) {
+        if (direction[i] > 0 && cameraLocation[i] > minBound[i]) return false;
+        if (direction[i] < 0 && cameraLocation[i] < maxBound[i]) return false;
     }
+    return true;
 }
 
 void Renderer::genScreenQuad() {
@@ -30,14 +30,51 @@ SOFTWARE.
 
 #include "render2D.h"
 #include "deferredFramebuffer.h"
+#include "occlusionBuffer.h"
+#include "bufferArena.h"
+#include "meshCache.h"
 #include "shaderManager.h"
 #include "../scene.h"
 #include "mesh.h"
+#include "tileMesh.h"
+#include "meshWorker.h"
+#include "rebuildScheduler.h"
+#include "frustum.h"
+#include "tileMesher.h"
+#include "blockInstancer.h"
+#include "lightBaker.h"
+#include "rayPicker.h"
+#include "lodBuilder.h"
 #include "halfEdge.h"
 #include "../eventManager.h"
 
 class Renderer {
 public:
+    typedef struct FrameStats {
+        unsigned int tilesDrawn = 0;
+        unsigned int tilesCulled = 0;
+        unsigned int tilesOccluded = 0;
+        unsigned int trianglesDrawn = 0;
+        unsigned int trianglesBackFacing = 0; /*< Skipped by normal bucket */
+        unsigned int tilesPerLevel[LodBuilder::NUM_LEVELS] = {0};
+        unsigned int drawCalls = 0; /*< Tile draw calls issued to the driver */
+        unsigned int drawRanges = 0; /*< Index ranges drawn by those calls */
+        unsigned int blockInstances = 0; /*< Drawn when instancing blocks */
+        float sceneCPUTime = 0.0f; /*< Milliseconds spent in renderScene */
+        float sceneGPUTime = 0.0f; /*< Of the latest frame measured, if any */
+    } FrameStats;
+
+    typedef struct MesherStats {
+        unsigned int tilesMeshed = 0;
+        unsigned long long vertices = 0;
+        unsigned long long triangles = 0;
+        float minVertexRatio = 0.0f; /*< Fewest vertices per triangle in a tile */
+        float maxVertexRatio = 0.0f;
+        unsigned long long cacheHits = 0; /*< Models shared, not meshed */
+        unsigned long long cacheMisses = 0;
+        unsigned long long slicesReused = 0; /*< Uploaded in place */
+    } MesherStats;
+
 	Renderer(int w, int h, glm::vec4 deferredArea, std::string id, EventManager* eventManager);
 
     ~Renderer();
@@ -72,6 +109,18 @@ public:
                           glm::ivec3& returnLocation, 
                           glm::vec3& returnNormal);
 
+/**
+  * Finds the blocks whose centres lie inside an outline on the screen and 
+  * are not hidden behind other blocks. Tiles are tested by their projected
+  * bounds first, and only the blocks of tiles overlapping the outline are
+  * tested one by one.
+  *
+  * @param outline Polygon in the coordinates of getMouseLocation, e.g. the 
+  *                corners of a box or the points of a lasso
+  */
+    std::vector<glm::ivec3> selectBlocks(Scene* scene, 
+                                         const std::vector<glm::vec2>& outline);
+
     void rebuildTile(Scene* scene, glm::ivec3 tileLocation);
 
     void update(double delta);
@@ -80,23 +129,72 @@ public:
 
     void exportScene(Scene* scene);
 
+    const FrameStats& getFrameStats();
+
+    const MesherStats& getMesherStats();
+
+    void printStats();
+
+/**
+  * Meshes every tile of the scene a few times on the calling thread, and
+  * prints the time and the number of heap allocations of each pass.
+  */
+    void benchmarkMeshing(Scene* scene);
+
     //void castRay(glm::vec2 coordinates);
 
 private:
     typedef struct ModelInfo {
-        GLuint vertexArrayObject;
-        GLuint vertexBufferObject;
-        GLuint normalBufferObject;
-        GLuint indexBufferObject;
-        GLuint colourIDBufferObject;
-        GLuint uvwBufferObject;
+        BufferArena::Allocation vertexAllocation; /*< TileVertex data */
+        BufferArena::Allocation indexAllocation;
         
-        unsigned int numIndices;
+        unsigned int numIndices = 0;
+        unsigned int numVertices = 0;
+        GLenum indexType = GL_UNSIGNED_INT; /*< 16 bits when the tile fits */
+
+        ContentKey cacheKey; /*< Content the model was built from */
+
+        unsigned int bucketStart[TileMesh::NUM_BUCKETS];
+        unsigned int bucketCount[TileMesh::NUM_BUCKETS];
 
         ModelInfo();
         ~ModelInfo();
     } ModelInfo;
 
+    typedef struct TileModels {
+        glm::ivec3 location; /*< Of the tile the models were built for */
+        ModelInfo* levels[LodBuilder::NUM_LEVELS] = {nullptr}; /*< Shared */
+        unsigned int revisions[LodBuilder::NUM_LEVELS] = {0}; /*< Of the tile,
+                                                             per model */
+        bool pending[LodBuilder::NUM_LEVELS] = {false}; /*< Queued on the worker */
+        int lastLevel = 0; /*< Level last drawn */
+    } TileModels;
+
+    typedef struct PendingContent {
+        std::vector<Scene::Block> blocks;
+        std::vector<std::pair<unsigned int, unsigned int>> tiles; /*< Handle
+                                            and revision of each tile waiting */
+    } PendingContent;
+
+/**
+  * Layout of a single command in GL_DRAW_INDIRECT_BUFFER.
+  */
+    typedef struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex; /*< In indices, not bytes */
+        GLint baseVertex;
+        GLuint baseInstance; /*< Selects the tile origin of the draw */
+    } DrawCommand;
+
+    typedef struct QueuedDraw {
+        int vertexPage;
+        int indexPage;
+        GLenum indexType;
+        glm::vec4 tileData; /*< Origin, and the tile ID bits for picking */
+        DrawCommand command;
+    } QueuedDraw;
+
     glm::vec4 deferredArea;
     glm::vec2 screenDimensions;
 
@@ -108,6 +206,28 @@ private:
 
     bool wireframe = false;
 
+    bool occlusionCulling = true;
+
+    bool ssao = false; /*< Screen space occlusion on top of the baked */
+
+    bool radiosity = false; /*< Light tiles with the baked irradiance */
+    LightBaker* lightBaker = nullptr; /*< Created when first toggled on */
+
+    bool instancedBlocks = false; /*< Draw blocks as instances, not tile meshes */
+
+    bool cpuPicking = true; /*< Cast rays, rather than reading the colour IDs */
+    RayPicker* rayPicker = nullptr; /*< Created on the first pick */
+    bool idPicked = false; /*< Whether the colour IDs have been picked from */
+    glm::vec2 pickCoordinates; /*< Where the colour IDs were last picked */
+
+    GLuint selectionBuffer; /*< Selected bits of each tile, by handle */
+    GLuint selectionTex; /*< Buffer texture of selectionBuffer */
+    unsigned int selectionRevision = 0; /*< Of the scene's selection */
+    bool selectionVisible = false; /*< Whether any block is selected */
+    unsigned int tileIDShift = 0; /*< See Scene::getMaxBytes */
+
+    OcclusionBuffer* occlusionBuffer; /*< Coarse depth buffer for culling tiles */
+
     Render2D* render2D; /**< Renderer for topmost level 2D rendering. */
     ShaderManager* shaderManager; /**< Loads and manages all of the application's shaders */
     DeferredFramebuffer* deferredFBO;  /**< Frame buffer for deferred rendering */
@@ -115,7 +235,32 @@ private:
     std::unordered_map<std::string, HalfEdge*> halfEdgeMeshes;
     std::unordered_map<std::string, std::vector<Mesh*>> meshes;
 
-    std::unordered_map<std::string, ModelInfo*> models;
+    std::vector<TileModels> tileModels; /*< Indexed by tile handle */
+    MeshCache<ModelInfo>* meshCache; /*< Owns every model */
+    std::vector<ModelInfo*> spareModels; /*< Evicted, see takeSpareModel */
+    std::unordered_map<ContentKey, PendingContent, ContentKeyHash> 
+        pendingContent; /*< Being built on the worker */
+
+    BufferArena* vertexArena; /*< Holds the vertices of every tile model */
+    BufferArena* indexArena;
+    std::vector<GLuint> pageVertexArrays; /*< One per vertex arena page */
+
+    bool multiDrawIndirect = false; /*< Set when the driver supports it */
+    std::vector<QueuedDraw> queuedDraws; /*< Tile index ranges of this frame */
+    std::vector<DrawCommand> drawCommands;
+    std::vector<glm::vec4> drawTileData; /*< Indexed by base instance */
+    GLuint drawCommandBuffer;
+    GLuint drawTileDataBuffer;
+
+    MeshWorker* meshWorker; /*< Builds tile meshes off the main thread */
+    RebuildScheduler* rebuildScheduler; /*< Modified tiles waiting for rebuilds */
+    TileMesher* tileMesher = nullptr; /*< Created once the meshes are loaded */
+    BlockInstancer* blockInstancer = nullptr; /*< Created when first toggled on */
+
+    bool timerQueries = false; /*< Set when the driver supports them */
+    GLuint sceneTimeQuery;
+    bool sceneTimeQueryPending = false; /*< Result not yet read back */
+    float sceneGPUTime = 0.0f;
 
     // The below values would optimally all be in a struct
     GLuint screenQuadVertexArray;
@@ -143,6 +288,11 @@ private:
     glm::mat4 cameraToClipMatrix;
     glm::mat4 worldToCameraMatrix;
 
+    glm::vec3 cameraLocation; /*< World space eye position, set per frame */
+
+    FrameStats frameStats; /*< Counters for the most recently rendered frame */
+    MesherStats mesherStats; /*< Totals over every tile mesh uploaded */
+
     std::mt19937 rndEngine;
     std::uniform_int_distribution<uint32_t> uintDist; 
 
@@ -154,9 +304,58 @@ private:
 
     void bufferWindowScale(int w, int h);
 
-    void renderTile(Scene* scene, glm::ivec3 tileLocation);
+    void renderTile(Scene* scene, Scene::Tile* tile);
+
+/**
+  * Draws the tiles with the block instancer, which is created on first use.
+  */
+    void renderTilesInstanced(Scene* scene, 
+                              const std::vector<Scene::Tile*>& tiles);
+
+    TileMesher* getTileMesher(Scene* scene);
+
+    RayPicker* getRayPicker(Scene* scene);
+
+    glm::vec2 getViewportDimensions();
+
+    void queueModel(ModelInfo* model, glm::vec4 tileData, 
+                    glm::vec3 minBound, glm::vec3 maxBound);
+
+/**
+  * Draws the ranges queued this frame, a call per buffer page combination
+  * with multi-draw indirect and a call per tile otherwise.
+  */
+    void submitDraws();
+
+    void submitDrawsIndirect();
+
+    void submitDrawsPerTile();
+
+    int selectLevel(Scene::Tile* tile, glm::vec3 minBound, glm::vec3 maxBound);
+
+    ModelInfo* getTileModel(Scene* scene, Scene::Tile* tile, int level);
+
+    void requestTileModel(Scene* scene, Scene::Tile* tile, int level);
+
+    void uploadTileModels(Scene* scene);
 
-    void buildTileVBO(Scene* scene, glm::ivec3 tileLocation);
+    TileModels& getTileModels(Scene::Tile* tile);
+
+    void clearTileModels(TileModels& models);
+
+    void setTileModel(TileModels& models, int level, ModelInfo* model, 
+                      unsigned int revision);
+
+    void scheduleRebuilds(Scene* scene, const Frustum& frustum);
+
+/**
+  * Uploads the selected blocks, if changed, for the lighting pass to 
+  * highlight by their colour IDs.
+  */
+    void uploadSelection(Scene* scene);
+
+    void cullOccludedTiles(Scene* scene, std::vector<Scene::Tile*>& tiles,
+                           const glm::mat4& worldToClipMatrix);
 
     void setRenderArea(glm::vec4 area, glm::vec2 screenDimensions);
 
@@ -189,15 +388,19 @@ private:
 
     Mesh* getBlockType(Scene::Block::BlockType blockType, int blockRotation);
 
-    void buildModel(const std::vector<float>& vertices,
-                    const std::vector<float>& normals,
-                    const std::vector<GLuint>& indices,
-                    const std::vector<float>& colourIDs,
-                    const std::vector<float>& uvw,
-                    Scene::Tile* tile);
+    void uploadModel(const TileMesh& tileMesh, ModelInfo* modelInfo);
+
+    void deleteModel(ModelInfo* modelInfo); /*< Or keeps it as a spare */
+
+/**
+  * A model evicted from the cache whose slices fit the mesh, or a new one
+  */
+    ModelInfo* takeSpareModel(const TileMesh& tileMesh);
+
+    GLuint getPageVertexArray(int page);
+
+    bool isBucketBackFacing(int bucket, glm::vec3 minBound, glm::vec3 maxBound);
 
-    glm::vec3 getTileColourID(glm::vec3 normal, int index,
-                              Scene* scene, Scene::Tile* tile);
 };
 
 #endif
\ No newline at end of file
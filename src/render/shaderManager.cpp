@@ -45,6 +45,7 @@ ShaderManager::ShaderManager() {
 
 ShaderManager::~ShaderManager() {
     glDeleteProgram(entityShader);
+    glDeleteProgram(blockInstanceShader);
     glDeleteProgram(baseLightingShader);
     glDeleteProgram(shader2D);
     glDeleteProgram(textShader);
@@ -150,10 +151,33 @@ void ShaderManager::initializePrograms() {
     textureToDraw = glGetUniformLocation(entityShader, "diffuseTex");
     glUniform1i(textureToDraw, 0);
 
+    textureToDraw = glGetUniformLocation(entityShader, "irradianceTex");
+    glUniform1i(textureToDraw, 1);
+
     glUseProgram(0);
 
     glUniformBlockBinding(entityShader, globalMatricesIndex, 0);
 
+    /* Initialize instanced block shader -------------------------------------*/
+
+    shaderList.push_back(createShader(GL_VERTEX_SHADER, Utility::programDirectory + "data/shaders/blockInstanceShader.vsh"));
+    shaderList.push_back(createShader(GL_FRAGMENT_SHADER, Utility::programDirectory + "data/shaders/entityShader.fsh"));
+
+    blockInstanceShader = createProgram(shaderList);
+
+    std::for_each(shaderList.begin(), shaderList.end(), glDeleteShader);
+    shaderList.clear();
+
+    globalMatricesIndex = glGetUniformBlockIndex(blockInstanceShader, "globalMatrices");
+
+    glUseProgram(blockInstanceShader);
+    textureToDraw = glGetUniformLocation(blockInstanceShader, "diffuseTex");
+    glUniform1i(textureToDraw, 0);
+
+    glUseProgram(0);
+
+    glUniformBlockBinding(blockInstanceShader, globalMatricesIndex, 0);
+
     /* Initialize base lighting shader ---------------------------------------*/
 
     shaderList.push_back(createShader(GL_VERTEX_SHADER, Utility::programDirectory + "data/shaders/baseLighting.vsh"));
@@ -182,6 +206,9 @@ void ShaderManager::initializePrograms() {
     textureToDraw = glGetUniformLocation(baseLightingShader, "noiseTex");
     glUniform1i(textureToDraw, 3);
 
+    textureToDraw = glGetUniformLocation(baseLightingShader, "selectionTex");
+    glUniform1i(textureToDraw, 4);
+
     glUseProgram(0);
 
     while ((err = glGetError()) != GL_NO_ERROR) {
@@ -291,6 +318,9 @@ void ShaderManager::initializePrograms() {
 const GLuint& ShaderManager::getEntityShader() {
 	return entityShader;
 }
+const GLuint& ShaderManager::getBlockInstanceShader() {
+    return blockInstanceShader;
+}
 const GLuint& ShaderManager::getBaseLightingShader() {
 	return baseLightingShader;
 }
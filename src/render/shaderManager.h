@@ -45,6 +45,7 @@ public:
 
 // The following are simple getters
     const GLuint& getEntityShader();
+    const GLuint& getBlockInstanceShader();
     const GLuint& getBaseLightingShader();
     const GLuint& getOcclusionBlurShader();
     const GLuint& getPostShader();
@@ -56,6 +57,7 @@ public:
 
 private:
     GLuint entityShader;       /**< Shader program for rendering entities */
+    GLuint blockInstanceShader; /**< Draws tiles block by block, see BlockInstancer */
     GLuint baseLightingShader;  
     GLuint occlusionBlurShader; 
     GLuint postShader;
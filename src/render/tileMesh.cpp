@@ -0,0 +1,199 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "tileMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+// Released meshes kept for reuse. Beyond this many they are freed, to bound 
+// the memory held by the pool.
+static const size_t maxPooledMeshes = 64;
+
+static std::mutex poolMutex;
+static std::vector<std::unique_ptr<TileMesh>> meshPool;
+
+TileMesh* TileMesh::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!meshPool.empty()) {
+            TileMesh* tileMesh = meshPool.back().release();
+            meshPool.pop_back();
+            return tileMesh;
+        }
+    }
+    return new TileMesh();
+}
+
+void TileMesh::release(TileMesh* tileMesh) {
+    tileMesh->clear();
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (meshPool.size() < maxPooledMeshes) {
+            meshPool.push_back(std::unique_ptr<TileMesh>(tileMesh));
+            return;
+        }
+    }
+    delete tileMesh;
+}
+
+void TileMesh::clear() {
+    vertices.clear();
+    indices.clear();
+    triangleBuckets.clear();
+    faceStart = 0;
+}
+
+void TileMesh::reserve(size_t numVertices, size_t numIndices) {
+    vertices.reserve(numVertices);
+    indices.reserve(numIndices);
+    triangleBuckets.reserve(numIndices / 3);
+}
+
+void TileMesh::addTriangle(const glm::vec3 positions[3], glm::vec3 normal,
+                           unsigned int colourID, unsigned int blockIndex,
+                           const uint8_t ambient[3]) {
+    int bucket = getBucket(normal);
+
+    TileVertex vertex;
+    // Every block normal points along the signs of its bucket, so the bucket
+    // alone is enough to reconstruct it
+    vertex.normal = bucket;
+    vertex.colourID = colourID;
+    vertex.block = blockIndex;
+    vertex.padding = 0;
+
+    // Only vertices of the same face can be identical, as the colour ID
+    // differs between faces
+    if (faceStart < vertices.size()) {
+        const TileVertex& first = vertices[faceStart];
+        if (first.normal != vertex.normal || first.block != vertex.block
+         || first.colourID != vertex.colourID) {
+            faceStart = vertices.size();
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        // Block corners lie half a block from the centres
+        glm::vec3 position = (positions[i] + 0.5f) * (float)POSITION_SCALE;
+        for (int j = 0; j < 3; j++) {
+            vertex.position[j] = (uint8_t)std::round(position[j]);
+        }
+        vertex.ambient = ambient[i];
+
+        size_t index = faceStart;
+        while (index < vertices.size()
+            && memcmp(&vertices[index], &vertex, sizeof(TileVertex)) != 0) {
+            index++;
+        }
+        if (index == vertices.size()) {
+            vertices.push_back(vertex);
+        }
+        indices.push_back(index);
+    }
+    triangleBuckets.push_back(bucket);
+}
+
+void TileMesh::sortBuckets(MeshScratch& scratch) {
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        bucketCount[i] = 0;
+    }
+    for (int bucket : triangleBuckets) {
+        bucketCount[bucket] += 3;
+    }
+    unsigned int bucketFill[NUM_BUCKETS];
+    unsigned int indexCount = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        bucketStart[i] = indexCount;
+        bucketFill[i] = indexCount;
+        indexCount += bucketCount[i];
+    }
+
+    ScratchVector<unsigned int>& sortedIndices = scratch.indices;
+    sortedIndices.resize(indices.size());
+    for (size_t i = 0; i < triangleBuckets.size(); i++) {
+        unsigned int target = bucketFill[triangleBuckets[i]];
+        bucketFill[triangleBuckets[i]] += 3;
+        std::copy(&indices[i * 3], &indices[i * 3] + 3, &sortedIndices[target]);
+    }
+    triangleBuckets.clear();
+
+    // Vertices in the order the triangles use them, for locality
+    const unsigned int unused = ~0u;
+    ScratchVector<unsigned int>& remap = scratch.remap;
+    remap.assign(vertices.size(), unused);
+    ScratchVector<TileVertex>& sortedVertices = scratch.vertices;
+    sortedVertices.clear();
+    for (unsigned int& index : sortedIndices) {
+        if (remap[index] == unused) {
+            remap[index] = sortedVertices.size();
+            sortedVertices.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    // The scratch keeps the old buffers, with their capacity, for next time
+    vertices.swap(sortedVertices);
+    indices.swap(sortedIndices);
+    faceStart = vertices.size();
+}
+
+unsigned int TileMesh::getColourID(glm::vec3 normal, unsigned int blockIndex) {
+    unsigned int faceID = 0;
+
+    if (normal.x < 0.0f) {
+        faceID = 1;
+    } else if (normal.y < 0.0f) {
+        faceID = 2;
+    } else if (normal.z < 0.0f) {
+        faceID = 3;
+    } else if (normal.y > 0.0f) {
+        faceID = 4;
+    } else if (normal.z > 0.0f) {
+        faceID = 5;
+    }
+
+    return blockIndex * 6 + 1 + faceID;
+}
+
+glm::vec3 TileMesh::getFaceNormal(unsigned int colourID) {
+    glm::vec3 normal(0.0f);
+
+    switch ((colourID - 1) % 6) {
+    case 0:
+        normal.x =  1.0f; break;
+    case 1:
+        normal.x = -1.0f; break;
+    case 2: 
+        normal.y = -1.0f; break;
+    case 3:
+        normal.z = -1.0f; break;
+    case 4:
+        normal.y =  1.0f; break;
+    case 5:
+        normal.z =  1.0f; break;
+    }
+    return normal;
+}
@@ -0,0 +1,160 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef TILEMESH_H
+#define TILEMESH_H
+
+#include <cstdint>
+#include <vector>
+#include "../../lib/glm/gtc/type_ptr.hpp"
+
+#include "countingAllocator.h"
+
+template <typename T>
+using ScratchVector = std::vector<T, CountingAllocator<T>>;
+
+/**
+  * Vertex of a tile mesh as uploaded to the GPU, 12 bytes in total. The
+  * tile's origin is supplied separately, so positions only need to cover
+  * the tile. Texture coordinates are derived from the block index in the
+  * vertex shader.
+  */
+typedef struct TileVertex {
+    uint8_t position[3]; /*< Tile-local, in quarter blocks from the tile corner */
+    uint8_t normal;      /*< Normal bucket, see TileMesh::getBucket */
+    uint32_t colourID;   /*< Picking ID of the face, see getColourID */
+    uint16_t block;      /*< Index of the block within the tile */
+    uint8_t ambient;     /*< Ambient light left by the neighbouring blocks,
+                             255 when unoccluded */
+    uint8_t padding;
+} TileVertex;
+
+/**
+  * Temporary buffers for building meshes, kept by each meshing thread so 
+  * that their capacity is reused from one build to the next.
+  */
+typedef struct MeshScratch {
+    ScratchVector<TileVertex> vertices;
+    ScratchVector<unsigned int> indices;
+    ScratchVector<unsigned int> remap;
+    ScratchVector<int> cells;
+} MeshScratch;
+
+/**
+  * CPU side mesh of a tile, ready for uploading. Triangles are sorted into
+  * buckets by the signs of their normal components (axis-aligned faces, the
+  * diagonal slopes and the corner slopes each land in their own buckets), so
+  * that the renderer can skip every bucket facing away from the camera.
+  * Triangles of the same block face share their vertices.
+  */
+struct TileMesh {
+    static const int NUM_BUCKETS = 27;
+
+    // Subdivisions of a block in the quantized vertex positions
+    static const int POSITION_SCALE = 4;
+
+    ScratchVector<TileVertex> vertices;
+    ScratchVector<unsigned int> indices;
+
+    // Range of indices belonging to each bucket
+    unsigned int bucketStart[NUM_BUCKETS];
+    unsigned int bucketCount[NUM_BUCKETS];
+
+/**
+  * Takes a cleared mesh from the pool of released meshes, which keep their
+  * capacity, or allocates a new one if the pool is empty. Thread safe.
+  */
+    static TileMesh* acquire();
+
+/**
+  * Returns a mesh to the pool. Thread safe.
+  */
+    static void release(TileMesh* tileMesh);
+
+    void clear();
+
+/**
+  * Reserves room for a mesh of the given size, e.g. the tile's previous mesh.
+  */
+    void reserve(size_t numVertices, size_t numIndices);
+
+/**
+  * Appends a triangle, reusing any identical vertices of the face added
+  * just before it.
+  *
+  * @param positions Corners relative to the centre of the tile's first block
+  * @param normal Normal of the face
+  * @param colourID Picking ID, see getColourID
+  * @param blockIndex Index of the block the triangle belongs to
+  * @param ambient Ambient light of each corner, see TileVertex
+  */
+    void addTriangle(const glm::vec3 positions[3], glm::vec3 normal,
+                     unsigned int colourID, unsigned int blockIndex,
+                     const uint8_t ambient[3]);
+
+/**
+  * Reorders the triangles added so far into bucket order and fills in the 
+  * bucket ranges. Vertices are renumbered in the order they are first used.
+  *
+  * @param scratch Buffers of the calling thread, swapped with the mesh's own
+  */
+    void sortBuckets(MeshScratch& scratch);
+
+    size_t getNumTriangles() const { return indices.size() / 3; }
+
+/**
+  * Encodes a block face as an ID for picking. The tile's ID is added in
+  * when drawing, so that meshes do not depend on which tile they are for.
+  *
+  * @param normal Normal of the face
+  * @param blockIndex Index of the block within its tile
+  * @return The ID, within the low Scene::getMaxBytes bits
+  */
+    static unsigned int getColourID(glm::vec3 normal, unsigned int blockIndex);
+
+/**
+  * @param colourID ID of a face, less the tile's bits
+  * @return The axis-aligned normal the face's ID stands for, e.g. the top
+  *         of a slope is picked as facing up
+  */
+    static glm::vec3 getFaceNormal(unsigned int colourID);
+
+    static int getBucket(glm::vec3 normal) {
+        auto sign = [](float value) {
+            return value > 0.001f ? 1 : (value < -0.001f ? -1 : 0);
+        };
+        return (sign(normal.x) + 1) * 9 + (sign(normal.y) + 1) * 3 
+             + (sign(normal.z) + 1);
+    }
+
+    static glm::ivec3 getBucketDirection(int bucket) {
+        return glm::ivec3(bucket / 9 - 1, (bucket / 3) % 3 - 1, bucket % 3 - 1);
+    }
+
+private:
+    ScratchVector<int> triangleBuckets;
+
+    size_t faceStart = 0; /*< First vertex of the face being added */
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "tileMesher.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Occluding blocks at which a vertex is as dark as baked occlusion gets, and
+// how much of the ambient light is then taken away
+static const float maxAmbientOccluders = 3.0f;
+static const float maxOcclusion = 0.6f;
+
+TileMesher::TileMesher(
+        const std::unordered_map<std::string, std::vector<Mesh*>>& meshes,
+        const Scene::VisibilityTable& visibilities) 
+            : visibilities(visibilities) {
+    typedef Scene::Block::BlockType BlockType;
+    const std::vector<std::pair<BlockType, std::string>> shapeNames = {
+        {BlockType::CUBE, "cube"},
+        {BlockType::SLOPE, "slope"},
+        {BlockType::RSLOPE, "rslope"},
+        {BlockType::DIAGONAL, "diagonal"},
+        {BlockType::CORNERSLOPE, "cornerSlope"},
+        {BlockType::RCORNERSLOPE, "rcornerSlope"},
+        {BlockType::INVCORNER, "invCorner"},
+        {BlockType::RINVCORNER, "rInvCorner"}
+    };
+    for (auto shapeName : shapeNames) {
+        auto meshIt = meshes.find(shapeName.second);
+        if (meshIt == meshes.end()) continue;
+        shapes[shapeName.first] = std::vector<const Mesh*>(
+            meshIt->second.begin(), meshIt->second.end());
+    }
+}
+
+uint8_t TileMesher::getAmbient(const Scene::TileSnapshot& snapshot,
+                               glm::ivec3 location, glm::vec3 vertex, 
+                               glm::vec3 normal) const {
+    // Blocks sharing the vertex: along each axis the vertex lies on a block
+    // boundary, both sides of it
+    glm::ivec3 from, to;
+    for (int i = 0; i < 3; i++) {
+        from[i] = vertex[i] < -0.25f ? -1 : 0;
+        to[i] = vertex[i] > 0.25f ? 1 : 0;
+    }
+
+    float occluders = 0.0f;
+    int sideCubes = 0;
+    for (int z = from.z; z <= to.z; z++) {
+        for (int y = from.y; y <= to.y; y++) {
+            for (int x = from.x; x <= to.x; x++) {
+                glm::ivec3 offset(x, y, z);
+                // Only the blocks in front of the face can shade it, which 
+                // for slopes includes blocks along two axes
+                if (glm::dot(glm::vec3(offset), normal) <= 0.001f) {
+                    continue;
+                }
+                const Scene::Block& block = snapshot.getBlock(location 
+                                                            + offset);
+                if (block.blockType == Scene::Block::BlockType::EMPTY) {
+                    continue;
+                }
+                bool cube = block.blockType == Scene::Block::BlockType::CUBE;
+                occluders += cube ? 1.0f : 0.5f;
+                int numAxes = (x != 0) + (y != 0) + (z != 0);
+                if (cube && numAxes == 2) {
+                    sideCubes++;
+                }
+            }
+        }
+    }
+    // Two cubes on either side of a corner hide the block diagonal to it
+    if (sideCubes >= 2) {
+        occluders = std::max(occluders, maxAmbientOccluders);
+    }
+    float ambient = 1.0f - maxOcclusion 
+                  * std::min(occluders, maxAmbientOccluders) 
+                  / maxAmbientOccluders;
+    return (uint8_t)std::round(ambient * 255.0f);
+}
+
+const Mesh* TileMesher::getShape(const Scene::Block& block) const {
+    auto shapeIt = shapes.find(block.blockType);
+    if (shapeIt == shapes.end()) {
+        return nullptr;
+    }
+    return shapeIt->second[block.rotation];
+}
+
+const std::map<Scene::Block::BlockType, std::vector<const Mesh*>>& 
+        TileMesher::getShapes() const {
+    return shapes;
+}
+
+Mesh::FaceVariant TileMesher::getFaceVariant(
+        const Scene::TileSnapshot& snapshot, glm::ivec3 location, 
+        const Mesh::Face& face) const {
+    int visibility = checkVisibility(snapshot, location, face);
+    int ownVisibility = face.triangle 
+        ? checkVisibilityDirection(snapshot, location, face) : 0;
+    return face.getVariant(visibility, ownVisibility);
+}
+
+int TileMesher::getVisibility(const Scene::Block& block, int direction) const {
+    auto visibilityIt = visibilities.find(block.blockType);
+    if (visibilityIt == visibilities.end()) {
+        return 1;
+    }
+    return visibilityIt->second[block.rotation][direction];
+}
+
+int TileMesher::checkVisibility(const Scene::TileSnapshot& snapshot,
+                                glm::ivec3 location, 
+                                const Mesh::Face& face) const {
+    if (face.neighbourSide == -1) {
+        return 1;
+    }
+    const Scene::Block& blockToCheck = 
+        snapshot.getBlock(location + face.neighbour);
+    if (blockToCheck.blockType == Scene::Block::BlockType::EMPTY) {
+        return 1;
+    }
+    return getVisibility(blockToCheck, face.neighbourSide);
+}
+
+int TileMesher::checkVisibilityDirection(const Scene::TileSnapshot& snapshot,
+                                         glm::ivec3 location, 
+                                         const Mesh::Face& face) const {
+    int visibilityValue = checkVisibility(snapshot, location, face);
+    const Scene::Block& blockToCheck = snapshot.getBlock(location);
+    if (visibilityValue != 0) {
+        int ownVisibility = getVisibility(blockToCheck, face.ownSide);
+        if (ownVisibility + visibilityValue != 0)
+            return ownVisibility;
+    }
+    return -1;
+}
+
+TileMesh* TileMesher::build(const Scene::TileSnapshot& snapshot, 
+                            MeshScratch& scratch, size_t vertexHint, 
+                            size_t indexHint) const {
+    TileMesh* tileMesh = TileMesh::acquire();
+    tileMesh->reserve(vertexHint, indexHint);
+    glm::ivec3 dimensions = snapshot.dimensions;
+
+    for (int i = 0; i < dimensions.x * dimensions.y * dimensions.z; i++) {
+        glm::ivec3 location(i % dimensions.x, (i / dimensions.x) % dimensions.y,
+                            i / (dimensions.x * dimensions.y));
+
+        const Mesh* mesh = getShape(snapshot.getBlock(location));
+        if (mesh == nullptr) {
+            continue;
+        }
+
+        for (const Mesh::Face& face : mesh->faces) {
+            Mesh::FaceVariant variant = getFaceVariant(snapshot, location, 
+                                                       face);
+            if (face.numTriangles[variant] == 0) {
+                continue;
+            }
+            // Every triangle of a face shares its normal, and so its ID
+            unsigned int colourID = TileMesh::getColourID(face.normal, i);
+            for (int t = 0; t < face.numTriangles[variant]; t++) {
+                const unsigned short* triangle = face.triangles[variant][t];
+                glm::vec3 positions[3];
+                uint8_t ambient[3];
+                for (int v = 0; v < 3; v++) {
+                    glm::vec3 vertex = mesh->vertices[triangle[v]];
+                    positions[v] = vertex + glm::vec3(location);
+                    ambient[v] = getAmbient(snapshot, location, vertex, 
+                                            face.normal);
+                }
+                tileMesh->addTriangle(positions, face.normal, colourID, i,
+                                      ambient);
+            }
+        }
+    }
+
+    tileMesh->sortBuckets(scratch);
+    return tileMesh;
+}
@@ -0,0 +1,103 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef TILEMESHER_H
+#define TILEMESHER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+#include "tileMesh.h"
+#include "../scene.h"
+
+/**
+  * Builds full detail tile meshes from snapshots, hiding the faces covered 
+  * by neighbouring blocks. Only reads data copied or fixed at construction,
+  * so any number of threads may build meshes at once.
+  */
+class TileMesher {
+public:
+/**
+  * @param meshes Block shapes by name, each in four rotations. The meshes
+  *               must outlive the mesher and not be modified.
+  * @param visibilities Visibility of the faces of each block type
+  */
+    TileMesher(const std::unordered_map<std::string, std::vector<Mesh*>>& meshes,
+               const Scene::VisibilityTable& visibilities);
+
+/**
+  * @param snapshot Tile to mesh
+  * @param scratch Buffers of the calling thread
+  * @param vertexHint Expected number of vertices, e.g. from the last build
+  * @param indexHint Expected number of indices
+  * @return The mesh, taken from the TileMesh pool. It has no vertices if 
+  *         every face is hidden.
+  */
+    TileMesh* build(const Scene::TileSnapshot& snapshot, MeshScratch& scratch,
+                    size_t vertexHint = 0, size_t indexHint = 0) const;
+
+/**
+  * @return Shape of the block in its rotation, or nullptr if it has none
+  */
+    const Mesh* getShape(const Scene::Block& block) const;
+
+/**
+  * Decides how much of a face the neighbouring blocks leave visible.
+  *
+  * @param location Tile-local location of the block the face belongs to
+  * @param face Face of the block's shape
+  */
+    Mesh::FaceVariant getFaceVariant(const Scene::TileSnapshot& snapshot,
+                                     glm::ivec3 location, 
+                                     const Mesh::Face& face) const;
+
+    const std::map<Scene::Block::BlockType, std::vector<const Mesh*>>& 
+        getShapes() const;
+
+private:
+    std::map<Scene::Block::BlockType, std::vector<const Mesh*>> shapes;
+    Scene::VisibilityTable visibilities;
+
+    int getVisibility(const Scene::Block& block, int direction) const;
+
+/**
+  * Bakes ambient occlusion for a vertex from the blocks around it in front
+  * of its face. Cubes occlude fully, other shapes by half.
+  *
+  * @param vertex Position relative to the centre of the block
+  * @return Ambient light reaching the vertex, see TileVertex
+  */
+    uint8_t getAmbient(const Scene::TileSnapshot& snapshot, glm::ivec3 location,
+                       glm::vec3 vertex, glm::vec3 normal) const;
+
+    int checkVisibility(const Scene::TileSnapshot& snapshot, 
+                        glm::ivec3 location, const Mesh::Face& face) const;
+
+    int checkVisibilityDirection(const Scene::TileSnapshot& snapshot,
+                                 glm::ivec3 location, 
+                                 const Mesh::Face& face) const;
+};
+
+#endif
@@ -23,7 +23,11 @@ SOFTWARE.
 ==============================================================================*/
 #include "scene.h"
 
+#include <chrono>
+
 #include "camera.h"
+#include "render/frustum.h"
+#include "sceneFile.h"
 #include "utility.h"
 
 Scene::Scene(std::string id, EventManager* eventManager) : 
@@ -67,12 +71,18 @@ unsigned int Scene::getMaxBytes() {
 }
 
 unsigned int Scene::getTileID(Tile* tile) {
-    for (int i = 0; i < tiles.size(); i++) {
-        if (tiles[i] == tile) {
-            return i;
-        }
+    return tile->handle;
+}
+
+Scene::Tile* Scene::getTileFromHandle(unsigned int handle) {
+    if (handle < tileHandles.size()) {
+        return tileHandles[handle];
     }
-    return 0;
+    return nullptr;
+}
+
+unsigned int Scene::getNumTileHandles() {
+    return tileHandles.size();
 }
 
 Scene::Tile* Scene::addTile(glm::ivec3 location) {
@@ -80,7 +90,23 @@ Scene::Tile* Scene::addTile(glm::ivec3 location) {
     tile->blocks.resize(tileDimensions.x * tileDimensions.y * tileDimensions.z);
     tile->location = location;
 
+    if (freeTileHandles.empty()) {
+        tile->handle = tileHandles.size();
+        tileHandles.push_back(tile);
+    } else {
+        tile->handle = freeTileHandles.back();
+        freeTileHandles.pop_back();
+        tileHandles[tile->handle] = tile;
+    }
+
     tiles.push_back(tile);
+    tileIndex[location] = tile;
+    if (tiles.size() == 1 && pendingTiles.empty()) {
+        minTileLocation = location;
+        maxTileLocation = location;
+    }
+    minTileLocation = glm::min(minTileLocation, location);
+    maxTileLocation = glm::max(maxTileLocation, location);
     return tile;
 }
 
@@ -93,12 +119,191 @@ Scene::~Scene() {
 
     eventManager->removeListener(id);
     delete listener;
+    delete streamFile;
 
     std::cout << "Scene deleted." << std::endl;
 }
 
-void Scene::save(std::string fileName) {
+void Scene::save(std::string fileName, bool raw) {
+    auto start = std::chrono::steady_clock::now();
+    streamAllTiles();
+    if (!SceneFile::write(fileName, tileDimensions, tiles, raw)) {
+        std::cout << "Could not save to " << fileName << std::endl;
+        return;
+    }
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() 
+                                       - start;
+    std::cout << "Saved " << tiles.size() << " tiles to " << fileName 
+              << " in " << time.count() << " s" << std::endl;
+}
 
+void Scene::load(std::string fileName) {
+    SceneFile* file = new SceneFile();
+    if (!file->open(fileName)) {
+        delete file;
+        return;
+    }
+    startStreaming(file, fileName);
+}
+
+void Scene::open(std::string fileName) {
+    SceneFile* file = new SceneFile();
+    if (!file->open(fileName, true)) {
+        delete file;
+        return;
+    }
+    startStreaming(file, fileName);
+}
+
+void Scene::startStreaming(SceneFile* file, std::string fileName) {
+    if (file->getTileDimensions() != tileDimensions) {
+        std::cout << fileName << " has tiles of a different size" << std::endl;
+        delete file;
+        return;
+    }
+
+    // Rebuilding the old locations drops their models
+    for (Tile* tile : tiles) {
+        addModifiedTile(tile->location);
+    }
+    removeAllTiles();
+    std::vector<Scene*> args = {this};
+    eventManager->addEvent({"renderer"}, Action::REBUILD_TILE, args);
+
+    delete streamFile;
+    streamFile = file;
+    pendingTiles.clear();
+    streamQueue.clear();
+    streamQueueKeyed = false;
+    const std::vector<SceneFile::TileEntry>& entries = streamFile->getTiles();
+    for (size_t i = 0; i < entries.size(); i++) {
+        pendingTiles[entries[i].location] = i;
+    }
+    updateTileRange();
+    std::cout << (streamFile->isMapped() ? "Mapped " : "Streaming ") 
+              << entries.size() << " tiles from " << fileName << std::endl;
+}
+
+size_t Scene::getNumPendingTiles() {
+    return pendingTiles.size();
+}
+
+void Scene::streamAllTiles() {
+    while (!pendingTiles.empty()) {
+        streamTile(pendingTiles.begin()->first);
+    }
+}
+
+Scene::Tile* Scene::streamTile(glm::ivec3 location) {
+    auto pendingIt = pendingTiles.find(location);
+    if (pendingIt == pendingTiles.end()) {
+        return nullptr;
+    }
+    const SceneFile::TileEntry& entry = streamFile->getTiles()[pendingIt->second];
+    pendingTiles.erase(pendingIt);
+
+    Tile* tile = nullptr;
+    std::vector<Block> blocks;
+    if (streamFile->readTile(entry, blocks)) {
+        tile = addTile(location);
+        tile->blocks.swap(blocks);
+        tile->revision = ++lastRevision;
+        updateTileBounds(tile);
+
+        // Neighbours meshed before now are missing this tile's blocks
+        for (int i = 0; i < 27; i++) {
+            glm::ivec3 side(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1);
+            if (side == glm::ivec3(0) || findLoadedTile(location + side)) {
+                addModifiedTile(location + side);
+            }
+        }
+        std::vector<Scene*> args = {this};
+        eventManager->addEvent({"renderer"}, Action::REBUILD_TILE, args);
+
+        if (tile->numBlocks == 0) {
+            removeTile(tile);
+            tile = nullptr;
+        }
+    } else {
+        std::cout << "Could not read tile " << location.x << ", " 
+                  << location.y << ", " << location.z << std::endl;
+    }
+    if (pendingTiles.empty()) {
+        std::cout << "Every tile streamed in" << std::endl;
+        delete streamFile;
+        streamFile = nullptr;
+        streamQueue.clear();
+        streamQueueKeyed = false;
+    }
+    return tile;
+}
+
+void Scene::setStreamView(const glm::mat4& worldToClipMatrix) {
+    streamView = worldToClipMatrix;
+    streamViewSet = true;
+}
+
+void Scene::streamTiles(glm::vec3 cameraLocation) {
+    if (pendingTiles.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    glm::vec3 tileSize(tileDimensions);
+    auto nearer = [](const std::pair<float, glm::ivec3>& a, 
+                     const std::pair<float, glm::ivec3>& b) {
+        return a.first > b.first;
+    };
+
+    // Tiles of a mapped file out of view are left in the mapping. Clip w is 
+    // the depth along the view direction, so its row is that direction.
+    bool inViewOnly = streamFile->isMapped() && streamViewSet;
+    glm::vec3 direction;
+    if (inViewOnly) {
+        direction = glm::normalize(glm::vec3(streamView[0][3], 
+                                             streamView[1][3], 
+                                             streamView[2][3]));
+    }
+
+    // Keyed again once the camera has moved by a tile, or turned. Building
+    // the heap is linear in the pending tiles, each tile popped logarithmic.
+    bool rekey = !streamQueueKeyed
+              || glm::length(cameraLocation - streamOrigin) > tileSize.x;
+    if (inViewOnly) {
+        rekey = rekey || glm::dot(direction, streamDirection) < maxStreamTurn;
+    } else {
+        rekey = rekey || streamQueue.empty();
+    }
+    if (rekey) {
+        streamOrigin = cameraLocation;
+        streamDirection = direction;
+        streamQueueKeyed = true;
+        streamQueue.clear();
+        Frustum frustum(streamView);
+        for (auto& pending : pendingTiles) {
+            // Block centres lie on integer coordinates
+            glm::vec3 minBound = glm::vec3(pending.first) * tileSize - 0.5f;
+            if (inViewOnly 
+             && !frustum.intersects(minBound, minBound + tileSize)) {
+                continue;
+            }
+            glm::vec3 center = minBound + tileSize * 0.5f;
+            streamQueue.push_back(std::make_pair(
+                glm::length(center - cameraLocation), pending.first));
+        }
+        std::make_heap(streamQueue.begin(), streamQueue.end(), nearer);
+    }
+    // At least one tile per frame
+    while (!streamQueue.empty()) {
+        glm::ivec3 location = streamQueue.front().second;
+        std::pop_heap(streamQueue.begin(), streamQueue.end(), nearer);
+        streamQueue.pop_back();
+        streamTile(location);
+        std::chrono::duration<float, std::milli> time = 
+            std::chrono::steady_clock::now() - start;
+        if (time.count() > streamBudget) {
+            break;
+        }
+    }
 }
 
 
@@ -133,16 +338,16 @@ bool Scene::removeBlock(glm::ivec3 location) {
         return false;
     }
     tile->blocks[index] = emptyBlock;
-
-
-    bool blockEmpty = true;
-    for (auto block : tile->blocks) {
-        if (block.blockType != Block::BlockType::EMPTY) {
-            blockEmpty = false;
-            break;
-        }
+    tile->revision = ++lastRevision;
+    uint64_t selectedBit = 1ull << (index % 64);
+    if (!tile->selected.empty() && (tile->selected[index / 64] & selectedBit)) {
+        tile->selected[index / 64] &= ~selectedBit;
+        tile->numSelected--;
+        selectionRevision++;
     }
-    if (blockEmpty) {
+
+    updateTileBounds(tile);
+    if (tile->numBlocks == 0) {
         removeTile(tile);
     }
     return true;
@@ -155,27 +360,123 @@ void Scene::removeTile(Scene::Tile* tile) {
             break;
         }
     }
+    tileIndex.erase(tile->location);
+    tileHandles[tile->handle] = nullptr;
+    freeTileHandles.push_back(tile->handle);
+    if (tile->numSelected > 0) {
+        selectionRevision++;
+    }
     delete tile;
+    updateTileRange();
 }
 
-Scene::Tile* Scene::findTile(glm::ivec3 location) {
-    Tile* rTile = nullptr;
+void Scene::removeAllTiles() {
     for (Tile* tile : tiles) {
-        if (tile->location == location) {
-            rTile = tile;
-            break;
-        }
+        tileHandles[tile->handle] = nullptr;
+        freeTileHandles.push_back(tile->handle);
+        delete tile;
+    }
+    tiles.clear();
+    tileIndex.clear();
+    selectionRevision++;
+}
+
+// Removing a tile may shrink the range, so it's found again
+void Scene::updateTileRange() {
+    std::vector<glm::ivec3> locations;
+    for (Tile* tile : tiles) {
+        locations.push_back(tile->location);
+    }
+    for (auto& pending : pendingTiles) {
+        locations.push_back(pending.first);
+    }
+    if (locations.empty()) {
+        return;
+    }
+    minTileLocation = locations[0];
+    maxTileLocation = locations[0];
+    for (glm::ivec3 location : locations) {
+        minTileLocation = glm::min(minTileLocation, location);
+        maxTileLocation = glm::max(maxTileLocation, location);
+    }
+}
+
+bool Scene::getTileRange(glm::ivec3& minLocation, glm::ivec3& maxLocation) {
+    if (tiles.empty() && pendingTiles.empty()) {
+        return false;
+    }
+    minLocation = minTileLocation;
+    maxLocation = maxTileLocation;
+    return true;
+}
+
+Scene::Tile* Scene::findTile(glm::ivec3 location) {
+    Tile* tile = findLoadedTile(location);
+    if (tile == nullptr && !pendingTiles.empty()) {
+        tile = streamTile(location);
+    }
+    return tile;
+}
+
+Scene::Tile* Scene::findLoadedTile(glm::ivec3 location) {
+    auto tileIt = tileIndex.find(location);
+    if (tileIt == tileIndex.end()) {
+        return nullptr;
     }
-    return rTile;
+    return tileIt->second;
 }
 
 glm::vec3 Scene::getTileLocation(unsigned int index) {
-    if (tiles.size() > index) {
-        return glm::vec3(tiles[index]->location);
+    Tile* tile = getTileFromHandle(index);
+    if (tile != nullptr) {
+        return glm::vec3(tile->location);
     }
     return glm::vec3(0.0f);
 }
 
+void Scene::updateTileBounds(Scene::Tile* tile) {
+    tile->numBlocks = 0;
+    tile->numCubes = 0;
+    for (size_t i = 0; i < tile->blocks.size(); i++) {
+        if (tile->blocks[i].blockType == Block::BlockType::EMPTY) {
+            continue;
+        }
+        if (tile->blocks[i].blockType == Block::BlockType::CUBE) {
+            tile->numCubes++;
+        }
+        glm::ivec3 blockLocation = getBlockLocation(i);
+        if (tile->numBlocks == 0) {
+            tile->minBlock = blockLocation;
+            tile->maxBlock = blockLocation;
+        } else {
+            tile->minBlock = glm::min(tile->minBlock, blockLocation);
+            tile->maxBlock = glm::max(tile->maxBlock, blockLocation);
+        }
+        tile->numBlocks++;
+    }
+}
+
+bool Scene::getTileBounds(Scene::Tile* tile, glm::vec3& minBound, 
+                          glm::vec3& maxBound) {
+    if (tile == nullptr || tile->numBlocks == 0) {
+        return false;
+    }
+    // Blocks are centered on their location, hence the half block padding
+    glm::vec3 tileOrigin = glm::vec3(tile->location * tileDimensions);
+    minBound = tileOrigin + glm::vec3(tile->minBlock) - glm::vec3(0.5f);
+    maxBound = tileOrigin + glm::vec3(tile->maxBlock) + glm::vec3(0.5f);
+    return true;
+}
+
+bool Scene::isSolidTile(Scene::Tile* tile) {
+    if (tile == nullptr || tile->numBlocks == 0) {
+        return false;
+    }
+    glm::ivec3 extent = tile->maxBlock - tile->minBlock + glm::ivec3(1);
+    unsigned int volume = extent.x * extent.y * extent.z;
+    return tile->numCubes == tile->numBlocks && tile->numBlocks == volume;
+}
+
 /*----------------------------------------------------------------------------*/
 
 void Scene::update(double delta) {
@@ -185,6 +486,8 @@ void Scene::update(double delta) {
     CameraComponent* cameraComponent = (CameraComponent*)camera
                                           ->getComponent(CameraComponent::key);
 
+    streamTiles(spatialComponent->location);
+
     for (auto event : listener->events) {
         switch (event->action) {
         case Action::START_MODIFYING : {
@@ -289,6 +592,31 @@ void Scene::update(double delta) {
             eventManager->addEvent({"state"}, Action::ROTATE_BLOCK, args);
             break;
         }
+        case Action::SELECT_BLOCKS : {
+            auto eventVec3 = std::dynamic_pointer_cast<Event<glm::vec3>>(event);
+            std::vector<glm::ivec3> locations;
+            for (glm::vec3 location : eventVec3->args) {
+                locations.push_back(glm::ivec3(location));
+            }
+            select(locations);
+            break;
+        }
+        case Action::CLEAR_SELECTION : {
+            clearSelection();
+            break;
+        }
+        case Action::DELETE_SELECTION : {
+            deleteSelection();
+            break;
+        }
+        case Action::RETYPE_SELECTION : {
+            retypeSelection(currentBlock);
+            break;
+        }
+        case Action::ROTATE_SELECTION : {
+            rotateSelection();
+            break;
+        }
         default:
             std::cout << "Sent invalid event." << std::endl;
             break;
@@ -319,46 +647,25 @@ void Scene::modifyBlock(glm::ivec3 location, glm::vec3 normal) {
     }
 
     if (samePlane) {
+        lastModifiedBlock = location;
         switch (mode) {
         case Mode::REMOVE : {
-            glm::ivec3 tileLocation;
-            tileLocation.x = floor((float)location.x / tileDimensions.x);
-            tileLocation.y = floor((float)location.y / tileDimensions.y);
-            tileLocation.z = floor((float)location.z / tileDimensions.z);
             if (removeBlock(location)) {
                 std::vector<std::string> ids = {"renderer"};
                 std::vector<Scene*> args = {this};
                 eventManager->addEvent(ids, Action::REBUILD_TILE, args);
-                bool alreadyAdded = false;
-                for (glm::ivec3 modTileLocation : modifiedTiles) {
-                    if (modTileLocation == tileLocation) {
-                        alreadyAdded = true;
-                        break;
-                    }
-                }
-                if (!alreadyAdded) modifiedTiles.push_back(tileLocation);
+                addModifiedBlock(location);
             }
             break;
         }
         case Mode::ADD : {
-            glm::ivec3 tileLocation;
-            tileLocation.x = floor((float)(location.x + normal.x) / tileDimensions.x);
-            tileLocation.y = floor((float)(location.y + normal.y) / tileDimensions.y);
-            tileLocation.z = floor((float)(location.z + normal.z) / tileDimensions.z);
             addBlock(glm::vec3(location) + normal, 
                      currentBlock, currentRotation, false);
 
             std::vector<std::string> ids = {"renderer"};
             std::vector<Scene*> args = {this};
             eventManager->addEvent(ids, Action::REBUILD_TILE, args);
-            bool alreadyAdded = false;
-            for (glm::ivec3 modTileLocation : modifiedTiles) {
-                if (modTileLocation == tileLocation) {
-                    alreadyAdded = true;
-                    break;
-                }
-            }
-            if (!alreadyAdded) modifiedTiles.push_back(tileLocation);
+            addModifiedBlock(location + glm::ivec3(normal));
             break;
         }
         case Mode::PAINT : {
@@ -417,10 +724,29 @@ void Scene::addBlock(glm::vec3 location, Block::BlockType blockType,
     int index = blockLocation.x + blockLocation.y * tileDimensions.x
                        + blockLocation.z * tileDimensions.x * tileDimensions.y;
 
+    bool wasEmpty = tile->blocks[index].blockType == Block::BlockType::EMPTY;
+    if (tile->blocks[index].blockType == Block::BlockType::CUBE) {
+        tile->numCubes--;
+    }
+    if (blockType == Block::BlockType::CUBE) {
+        tile->numCubes++;
+    }
 
     tile->blocks[index].rotation = rotation;
     tile->blocks[index].flipped = flipped;
     tile->blocks[index].blockType = blockType;
+    tile->revision = ++lastRevision;
+
+    if (wasEmpty && blockType != Block::BlockType::EMPTY) {
+        if (tile->numBlocks == 0) {
+            tile->minBlock = blockLocation;
+            tile->maxBlock = blockLocation;
+        } else {
+            tile->minBlock = glm::min(tile->minBlock, blockLocation);
+            tile->maxBlock = glm::max(tile->maxBlock, blockLocation);
+        }
+        tile->numBlocks++;
+    }
 }
 
 Entity* Scene::getEntity(std::string entityId) {
@@ -431,18 +757,221 @@ Entity* Scene::getEntity(std::string entityId) {
 }
 
 Scene::Tile* Scene::getTile(glm::ivec3 location) {
-    return findTile(location);
+    return findLoadedTile(location);
 }
 
 std::vector<Scene::Tile*>& Scene::getTiles() {
     return tiles;
 }
 
-std::vector<glm::ivec3>& Scene::getModifiedTiles() {
+Scene::TileSnapshot Scene::getTileSnapshot(Tile* tile) {
+    TileSnapshot snapshot;
+    snapshot.location = tile->location;
+    snapshot.dimensions = tileDimensions;
+    snapshot.revision = tile->revision;
+
+    glm::ivec3 size = tileDimensions + 2;
+    snapshot.blocks.resize(size.x * size.y * size.z, emptyBlock);
+
+    auto copyBlocks = [&](Tile* source, glm::ivec3 from, glm::ivec3 to) {
+        for (int z = from.z; z < to.z; z++) {
+            for (int y = from.y; y < to.y; y++) {
+                for (int x = from.x; x < to.x; x++) {
+                    glm::ivec3 location(x, y, z);
+                    // Wraps the apron around to the neighbour's far side
+                    glm::ivec3 sourceLocation = (location + tileDimensions) 
+                                              % tileDimensions;
+                    glm::ivec3 target = location + 1;
+                    snapshot.blocks[target.x + target.y * size.x 
+                                  + target.z * size.x * size.y] = 
+                        source->blocks[sourceLocation.x 
+                                     + sourceLocation.y * tileDimensions.x
+                                     + sourceLocation.z * tileDimensions.x 
+                                                        * tileDimensions.y];
+                }
+            }
+        }
+    };
+
+    copyBlocks(tile, glm::ivec3(0), tileDimensions);
+
+    // Every neighbour, as the baked occlusion of a vertex also depends on 
+    // the blocks across the tile's edges and corners
+    for (int i = 0; i < 27; i++) {
+        glm::ivec3 side(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1);
+        if (side == glm::ivec3(0)) {
+            continue;
+        }
+        Tile* neighbour = findLoadedTile(tile->location + side);
+        if (neighbour == nullptr) {
+            continue;
+        }
+        glm::ivec3 from(0);
+        glm::ivec3 to = tileDimensions;
+        for (int axis = 0; axis < 3; axis++) {
+            if (side[axis] != 0) {
+                from[axis] = side[axis] < 0 ? -1 : tileDimensions[axis];
+                to[axis] = from[axis] + 1;
+            }
+        }
+        copyBlocks(neighbour, from, to);
+    }
+
+    return snapshot;
+}
+
+const Scene::VisibilityTable& Scene::getBlockVisibilities() const {
+    return blockVisibilities;
+}
+
+glm::ivec3 Scene::getLastModifiedBlock() {
+    return lastModifiedBlock;
+}
+
+void Scene::select(const std::vector<glm::ivec3>& locations) {
+    clearSelection();
+    size_t numWords = (tileDimensions.x * tileDimensions.y * tileDimensions.z 
+                       + 63) / 64;
+    for (glm::ivec3 location : locations) {
+        glm::ivec3 tileLocation = glm::ivec3(
+            glm::floor(glm::vec3(location) / glm::vec3(tileDimensions)));
+        Tile* tile = findLoadedTile(tileLocation);
+        if (tile == nullptr) {
+            continue;
+        }
+        glm::ivec3 blockLocation = location - tileLocation * tileDimensions;
+        unsigned int index = blockLocation.x 
+                           + blockLocation.y * tileDimensions.x
+                           + blockLocation.z * tileDimensions.x 
+                                             * tileDimensions.y;
+        if (tile->blocks[index].blockType == Block::BlockType::EMPTY) {
+            continue;
+        }
+        if (tile->selected.empty()) {
+            tile->selected.resize(numWords, 0);
+        }
+        uint64_t bit = 1ull << (index % 64);
+        if (!(tile->selected[index / 64] & bit)) {
+            tile->selected[index / 64] |= bit;
+            tile->numSelected++;
+        }
+    }
+    selectionRevision++;
+    std::cout << "Selected " << getNumSelected() << " blocks" << std::endl;
+}
+
+void Scene::clearSelection() {
+    for (Tile* tile : tiles) {
+        tile->selected.clear();
+        tile->numSelected = 0;
+    }
+    selectionRevision++;
+}
+
+unsigned int Scene::getSelectionRevision() {
+    return selectionRevision;
+}
+
+unsigned int Scene::getNumSelected() {
+    unsigned int numSelected = 0;
+    for (Tile* tile : tiles) {
+        numSelected += tile->numSelected;
+    }
+    return numSelected;
+}
+
+void Scene::editSelection(const std::function<void(Block&)>& edit) {
+    // Copied, as tiles left without blocks are removed
+    std::vector<Tile*> selectedTiles;
+    for (Tile* tile : tiles) {
+        if (tile->numSelected > 0) {
+            selectedTiles.push_back(tile);
+        }
+    }
+    if (selectedTiles.empty()) {
+        return;
+    }
+    for (Tile* tile : selectedTiles) {
+        for (size_t word = 0; word < tile->selected.size(); word++) {
+            uint64_t bits = tile->selected[word];
+            for (int bit = 0; bits != 0; bit++, bits >>= 1) {
+                Block& block = tile->blocks[word * 64 + bit];
+                if ((bits & 1) && block.blockType != Block::BlockType::EMPTY) {
+                    edit(block);
+                    addModifiedBlock(tile->location * tileDimensions 
+                                   + getBlockLocation(word * 64 + bit));
+                }
+            }
+        }
+        tile->revision = ++lastRevision;
+        addModifiedTile(tile->location);
+        updateTileBounds(tile);
+        if (tile->numBlocks == 0) {
+            removeTile(tile);
+        }
+    }
+    std::vector<Scene*> args = {this};
+    eventManager->addEvent({"renderer"}, Action::REBUILD_TILE, args);
+}
+
+void Scene::deleteSelection() {
+    editSelection([this](Block& block) {
+        block = emptyBlock;
+    });
+    clearSelection();
+}
+
+void Scene::retypeSelection(Block::BlockType blockType) {
+    editSelection([blockType](Block& block) {
+        block.blockType = blockType;
+    });
+}
+
+void Scene::rotateSelection() {
+    editSelection([](Block& block) {
+        block.rotation = (block.rotation + 1) % 4;
+    });
+}
+
+void Scene::addModifiedBlock(glm::ivec3 location) {
+    glm::ivec3 tileLocation = glm::ivec3(
+        glm::floor(glm::vec3(location) / glm::vec3(tileDimensions)));
+    glm::ivec3 blockLocation = location - tileLocation * tileDimensions;
+    // Meshes read the blocks bordering their tile, see getTileSnapshot, so 
+    // the tiles a border block touches, corners included, are rebuilt too
+    for (int i = 0; i < 27; i++) {
+        glm::ivec3 side(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1);
+        bool touches = true;
+        for (int axis = 0; axis < 3; axis++) {
+            if ((side[axis] < 0 && blockLocation[axis] != 0)
+             || (side[axis] > 0 
+              && blockLocation[axis] != tileDimensions[axis] - 1)) {
+                touches = false;
+            }
+        }
+        if (touches && (side == glm::ivec3(0) 
+                     || findLoadedTile(tileLocation + side))) {
+            addModifiedTile(tileLocation + side);
+        }
+    }
+}
+
+void Scene::addModifiedTile(glm::ivec3 tileLocation) {
+    if (modifiedTileSet.insert(tileLocation).second) {
+        modifiedTiles.push_back(tileLocation);
+    }
+}
+
+const std::vector<glm::ivec3>& Scene::getModifiedTiles() {
     return modifiedTiles;
 }
 
-Scene::Block& Scene::getBlock(glm::ivec3 location) {
+void Scene::clearModifiedTiles() {
+    modifiedTiles.clear();
+    modifiedTileSet.clear();
+}
+
+Scene::Block Scene::getBlock(glm::ivec3 location) {
     glm::ivec3 tileLocation;
     tileLocation.x = floor((float)location.x / tileDimensions.x);
     tileLocation.y = floor((float)location.y / tileDimensions.y);
@@ -458,14 +987,22 @@ Scene::Block& Scene::getBlock(glm::ivec3 location) {
     blockLocation.y += blockLocation.y < 0 ? tileDimensions.y : 0;
     blockLocation.z += blockLocation.z < 0 ? tileDimensions.z : 0;
 
-    Tile* tile = findTile(tileLocation);
+    Tile* tile = findLoadedTile(tileLocation);
+
+    unsigned int index = blockLocation.x + blockLocation.y * tileDimensions.x + 
+                         blockLocation.z * tileDimensions.x * tileDimensions.y;
 
     if (tile == nullptr) {
+        // Pending tiles of a mapped file are read without copying them out
+        auto pendingIt = pendingTiles.find(tileLocation);
+        if (pendingIt != pendingTiles.end() && streamFile->isMapped()) {
+            const uint8_t* blocks = streamFile->getMappedBlocks(
+                                    streamFile->getTiles()[pendingIt->second]);
+            return SceneFile::unpackBlock(blocks[index]);
+        }
         return emptyBlock;
     }
 
-    unsigned int index = blockLocation.x + blockLocation.y * tileDimensions.x + 
-                         blockLocation.z * tileDimensions.x * tileDimensions.y;
     return tile->blocks[index];
 }
 
@@ -534,7 +1071,7 @@ int Scene::checkVisibility(glm::ivec3 blockLocation, glm::vec3 direction) {
     if (fabs(direction.x) + fabs(direction.y) + fabs(direction.z) != 1.0f) {
         return 1;
     }
-    Block& blockToCheck = getBlock(blockLocation + glm::ivec3(direction));
+    Block blockToCheck = getBlock(blockLocation + glm::ivec3(direction));
     if (blockToCheck.blockType == Block::BlockType::EMPTY) {
         return 1;
     }
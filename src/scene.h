@@ -25,11 +25,16 @@ SOFTWARE.
 #define SCENE_H
 
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <cstdint>
+#include <functional>
 #include <string>
 
 #include "entity.h"
 #include "eventManager.h"
 
+class SceneFile;
+
 class Scene {
 public:
     // For checking triangle visibility
@@ -55,8 +60,39 @@ public:
     typedef struct Tile {
         std::vector<Block> blocks;
         glm::ivec3 location;
+        // Bounds of the occupied blocks, in tile-local block coordinates
+        glm::ivec3 minBlock = glm::ivec3(0);
+        glm::ivec3 maxBlock = glm::ivec3(0);
+        unsigned int numBlocks = 0;
+        unsigned int numCubes = 0;
+        unsigned int revision = 0; // Set whenever a block changes, never 
+                                   // repeated by any tile of the scene
+        unsigned int handle = 0; // Stable while the tile exists, then reused
+        std::vector<uint64_t> selected; // One bit per block, empty if none is
+        unsigned int numSelected = 0;
     } Tile;
 
+    // Copy of a tile and the blocks bordering it, for meshing off the main 
+    // thread. The apron includes the blocks across the edges and corners.
+    typedef struct TileSnapshot {
+        glm::ivec3 location;
+        glm::ivec3 dimensions;
+        unsigned int revision;
+        std::vector<Block> blocks; // dimensions + 2 per side, apron included
+
+        // Location is tile-local, from -1 to dimensions inclusive
+        const Block& getBlock(glm::ivec3 location) const {
+            location += 1;
+            glm::ivec3 size = dimensions + 2;
+            return blocks[location.x + location.y * size.x 
+                        + location.z * size.x * size.y];
+        }
+    } TileSnapshot;
+
+    // Per block type and rotation: front, right, back, left, bottom, top
+    typedef std::map<Block::BlockType, std::vector<std::vector<int>>> 
+        VisibilityTable;
+
     std::vector<Tile*> tiles;
 
     Scene(std::string id, EventManager* eventManager);
@@ -81,9 +117,17 @@ public:
 
     unsigned int getTileID(Tile*);
 
+    Tile* getTileFromHandle(unsigned int handle);
+
+    unsigned int getNumTileHandles(); // Upper bound of the handles in use
+
+    // Smallest and largest tile location in use, false if there are no tiles
+    bool getTileRange(glm::ivec3& minLocation, glm::ivec3& maxLocation);
+
     std::vector<Tile*>& getTiles();
 
-    Block& getBlock(glm::ivec3 blockLocation);
+    // A copy, as the blocks of a mapped file need not be in any tile
+    Block getBlock(glm::ivec3 blockLocation);
 
     glm::ivec3 getTileDimensions();
 
@@ -101,13 +145,60 @@ public:
 
     bool removeBlock(glm::ivec3 location);
 
-    std::vector<glm::ivec3>& getModifiedTiles();
+    const std::vector<glm::ivec3>& getModifiedTiles();
+
+    void clearModifiedTiles(); // Once the renderer has queued them
+
+    glm::ivec3 getLastModifiedBlock(); // Where the user last edited
+
+    // Replaces the selection. Empty locations are left out.
+    void select(const std::vector<glm::ivec3>& locations);
+
+    void clearSelection();
+
+    unsigned int getNumSelected();
+
+    // Changes whenever the selected blocks do, for the renderer to upload
+    unsigned int getSelectionRevision();
+
+    // Bulk edits of the selected blocks. Each tile is rebuilt once.
+    void deleteSelection();
+
+    void retypeSelection(Block::BlockType blockType);
+
+    void rotateSelection(); // Each block about its own y axis
 
     unsigned int getMaxBytes();
 
     glm::vec3 getTileLocation(unsigned int index);
 
-    void save(std::string fileName);
+    bool getTileBounds(Tile* tile, glm::vec3& minBound, glm::vec3& maxBound);
+
+    bool isSolidTile(Tile* tile);
+
+    TileSnapshot getTileSnapshot(Tile* tile);
+
+    const VisibilityTable& getBlockVisibilities() const;
+
+    void save(std::string fileName, bool raw = false);
+
+    // Replaces every tile with those of a saved scene. Only the file's tile
+    // directory is read at once. Tiles are decoded when first looked up, or
+    // else streamed in nearest the camera first, a few milliseconds a frame.
+    void load(std::string fileName);
+
+    // Like load, but maps a raw file (see "save <name> raw") read-only. 
+    // Tiles are only streamed in, i.e. copied out of the mapping, once within
+    // the view (see setStreamView) or edited. getBlock reads the others' blocks 
+    // straight from the mapping.
+    void open(std::string fileName);
+
+    size_t getNumPendingTiles(); // Still to be streamed in
+
+    // The view the scene was last drawn with, see open
+    void setStreamView(const glm::mat4& worldToClipMatrix);
+
+    void streamAllTiles();
 
 private:
     std::string id;
@@ -117,12 +208,50 @@ private:
 
     std::vector<glm::ivec3> modifiedTiles;
 
+    struct TileLocationHash {
+        size_t operator()(const glm::ivec3& location) const {
+            return (size_t)location.x * 73856093 
+                 ^ (size_t)location.y * 19349663
+                 ^ (size_t)location.z * 83492791;
+        }
+    };
+
+    // Of modifiedTiles, so that adding to them doesn't scan them
+    boost::unordered_set<glm::ivec3, TileLocationHash> modifiedTileSet;
+
+    // Tiles by location, so that lookups don't scan every tile
+    boost::unordered_map<glm::ivec3, Tile*, TileLocationHash> tileIndex;
+    glm::ivec3 minTileLocation = glm::ivec3(0);
+    glm::ivec3 maxTileLocation = glm::ivec3(0);
+
+    // Tiles of the loaded file not decoded yet, by index in its directory
+    SceneFile* streamFile = nullptr;
+    boost::unordered_map<glm::ivec3, size_t, TileLocationHash> pendingTiles;
+    // Pending tiles by distance from streamOrigin, a heap with the nearest
+    // on top. Tiles streamed in out of order are skipped when popped.
+    std::vector<std::pair<float, glm::ivec3>> streamQueue;
+    bool streamQueueKeyed = false;
+    glm::vec3 streamOrigin;
+    glm::vec3 streamDirection; // Of the view streamQueue was keyed for
+    const float streamBudget = 4.0f; // Milliseconds per frame
+    const float maxStreamTurn = 0.99f; // Cosine of the turn that rekeys
+
+    // Set by the renderer. Only the tiles of a mapped file within the view
+    // are streamed in.
+    glm::mat4 streamView;
+    bool streamViewSet = false;
+
+    std::vector<Tile*> tileHandles; // Indexed by handle, null when free
+    std::vector<unsigned int> freeTileHandles;
+    unsigned int lastRevision = 0;
+    unsigned int selectionRevision = 0;
+
     EventManager* eventManager;
     Listener* listener;
 
     unsigned int maxColourIDBytes;
 
-    std::map<Block::BlockType, std::vector<std::vector<int>>> blockVisibilities;
+    VisibilityTable blockVisibilities;
 
     Block emptyBlock;
 
@@ -131,6 +260,7 @@ private:
 
     bool modify = false;
     glm::ivec3 initialLocation;
+    glm::ivec3 lastModifiedBlock = glm::ivec3(0);
     glm::vec3 initialNormal;
 
     enum class Mode {
@@ -152,11 +282,37 @@ private:
 
     Tile* addTile(glm::ivec3 location);
 
+    // Streams the tile in if pending. Used when editing, so that edits 
+    // land in the saved tile.
     Tile* findTile(glm::ivec3 location);
 
+    // Lookups that only see the tiles streamed in, and so never add to the
+    // tiles while they are being iterated over
+    Tile* findLoadedTile(glm::ivec3 location);
+
+    void startStreaming(SceneFile* file, std::string fileName);
+
+    Tile* streamTile(glm::ivec3 location);
+
+    void streamTiles(glm::vec3 cameraLocation);
+
     void calcMaxBytes();
 
     void removeTile(Tile* tile);
+
+    void removeAllTiles();
+
+    void updateTileRange();
+
+    void addModifiedTile(glm::ivec3 tileLocation);
+
+    // The block's tile, and the neighbours whose borders it lies on
+    void addModifiedBlock(glm::ivec3 location);
+
+    // Applies the edit to every selected block, then updates the tiles
+    void editSelection(const std::function<void(Block&)>& edit);
+
+    void updateTileBounds(Tile* tile);
 };
 
 #endif
\ No newline at end of file
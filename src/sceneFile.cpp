@@ -0,0 +1,373 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#include "sceneFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lodepng.h"
+
+static const char magic[4] = {'V', 'X', 'C', 'S'};
+static const size_t headerSize = 32;
+static const size_t entrySize = 32;
+static const uint32_t maxTileDimension = 256;
+
+static void putU32(std::vector<unsigned char>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (i * 8)) & 0xff;
+    }
+}
+
+static void putU64(std::vector<unsigned char>& out, size_t at, uint64_t value) {
+    putU32(out, at, (uint32_t)value);
+    putU32(out, at + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t getU32(const unsigned char* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint64_t getU64(const unsigned char* in) {
+    return getU32(in) | ((uint64_t)getU32(in + 4) << 32);
+}
+
+SceneFile::~SceneFile() {
+    close();
+}
+
+bool SceneFile::write(const std::string& fileName, glm::ivec3 tileDimensions,
+                      const std::vector<Scene::Tile*>& tiles, bool raw) {
+    std::vector<unsigned char> header(headerSize + entrySize * tiles.size(), 0);
+    std::memcpy(header.data(), magic, 4);
+    putU32(header, 4, VERSION);
+    for (int i = 0; i < 3; i++) {
+        putU32(header, 8 + i * 4, (uint32_t)tileDimensions[i]);
+    }
+    putU32(header, 20, (uint32_t)tiles.size());
+    putU32(header, 24, raw ? FLAG_RAW : 0);
+
+    // Tiles are small, so building a Huffman tree per tile costs more than
+    // it saves. Fixed codes write millions of blocks in a second or two.
+    LodePNGCompressSettings settings = lodepng_default_compress_settings;
+    settings.btype = 1;
+    settings.windowsize = 512;
+    settings.lazymatching = 0;
+
+    // Each thread compresses a share of the tiles
+    std::vector<std::vector<unsigned char>> payloads(tiles.size());
+    std::atomic<bool> failed(false);
+    auto compressTiles = [&](size_t from, size_t to) {
+        std::vector<unsigned char> packed;
+        for (size_t i = from; i < to; i++) {
+            packed.resize(tiles[i]->blocks.size());
+            for (size_t j = 0; j < packed.size(); j++) {
+                packed[j] = packBlock(tiles[i]->blocks[j]);
+            }
+            if (raw) {
+                payloads[i].swap(packed);
+            } else if (lodepng::compress(payloads[i], packed, settings) != 0) {
+                failed = true;
+            }
+        }
+    };
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t share = (tiles.size() + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+    for (size_t from = 0; from < tiles.size(); from += share) {
+        threads.emplace_back(compressTiles, from, 
+                             std::min(from + share, tiles.size()));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        std::cout << "Could not compress the tiles" << std::endl;
+        return false;
+    }
+
+    uint64_t offset = header.size();
+    for (size_t i = 0; i < tiles.size(); i++) {
+        size_t entry = headerSize + entrySize * i;
+        for (int axis = 0; axis < 3; axis++) {
+            putU32(header, entry + axis * 4, (uint32_t)tiles[i]->location[axis]);
+        }
+        putU32(header, entry + 12, tiles[i]->numBlocks);
+        putU64(header, entry + 16, offset);
+        putU32(header, entry + 24, (uint32_t)payloads[i].size());
+        offset += payloads[i].size();
+    }
+
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "Could not open " << fileName << " for writing" 
+                  << std::endl;
+        return false;
+    }
+    out.write((const char*)header.data(), header.size());
+    for (auto& payload : payloads) {
+        out.write((const char*)payload.data(), payload.size());
+    }
+    return (bool)out;
+}
+
+bool SceneFile::open(const std::string& fileName, bool map) {
+    close();
+    if (map) {
+        if (!mapFile(fileName)) {
+            return false;
+        }
+        fileSize = mappingSize;
+        if (mappingSize < headerSize || std::memcmp(mapping, magic, 4) != 0) {
+            std::cout << fileName << " is not a scene file" << std::endl;
+            close();
+            return false;
+        }
+        size_t directorySize = entrySize * getU32(mapping + 20);
+        if (!readDirectory(fileName, mapping, mapping + headerSize, 
+                           directorySize)) {
+            return false;
+        }
+        if (!(flags & FLAG_RAW)) {
+            std::cout << fileName << " is compressed, so it cannot be mapped"
+                      << std::endl;
+            close();
+            return false;
+        }
+        size_t numBlocks = 
+            tileDimensions.x * tileDimensions.y * tileDimensions.z;
+        for (auto& entry : tiles) {
+            if (entry.size != numBlocks) {
+                std::cout << fileName << " is corrupt" << std::endl;
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    file.open(fileName, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cout << "Could not open " << fileName << std::endl;
+        return false;
+    }
+    fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+    unsigned char header[headerSize];
+    if (!file.read((char*)header, headerSize) 
+     || std::memcmp(header, magic, 4) != 0) {
+        std::cout << fileName << " is not a scene file" << std::endl;
+        close();
+        return false;
+    }
+    // Checked before allocating, as the count may be garbage
+    uint64_t directorySize = (uint64_t)entrySize * getU32(header + 20);
+    if (directorySize > fileSize - headerSize) {
+        std::cout << fileName << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    std::vector<unsigned char> directory(directorySize);
+    if (!file.read((char*)directory.data(), directory.size())) {
+        std::cout << fileName << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    return readDirectory(fileName, header, directory.data(), directory.size());
+}
+
+bool SceneFile::readDirectory(const std::string& fileName, 
+                              const unsigned char* header, 
+                              const unsigned char* directory, 
+                              size_t directorySize) {
+    // The header is at the start of the file, and was checked for the magic
+    if (directorySize > fileSize - headerSize) {
+        std::cout << fileName << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    uint32_t version = getU32(header + 4);
+    if (version != VERSION) {
+        std::cout << fileName << " has version " << version 
+                  << ", expected " << VERSION << std::endl;
+        close();
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        uint32_t dimension = getU32(header + 8 + i * 4);
+        if (dimension == 0 || dimension > maxTileDimension) {
+            std::cout << fileName << " is corrupt" << std::endl;
+            close();
+            return false;
+        }
+        tileDimensions[i] = (int)dimension;
+    }
+    flags = getU32(header + 24);
+
+    tiles.resize(directorySize / entrySize);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        const unsigned char* entry = directory + i * entrySize;
+        for (int axis = 0; axis < 3; axis++) {
+            tiles[i].location[axis] = (int32_t)getU32(entry + axis * 4);
+        }
+        tiles[i].numBlocks = getU32(entry + 12);
+        tiles[i].offset = getU64(entry + 16);
+        tiles[i].size = getU32(entry + 24);
+        if (tiles[i].offset > fileSize 
+         || tiles[i].size > fileSize - tiles[i].offset) {
+            std::cout << fileName << " is truncated" << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneFile::mapFile(const std::string& fileName) {
+#if !defined(_WIN32)
+    int descriptor = ::open(fileName.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        std::cout << "Could not open " << fileName << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        std::cout << fileName << " is not a scene file" << std::endl;
+        ::close(descriptor);
+        return false;
+    }
+    // The mapping stays valid after the descriptor is closed
+    void* address = mmap(nullptr, (size_t)status.st_size, PROT_READ, 
+                         MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (address == MAP_FAILED) {
+        std::cout << "Could not map " << fileName << std::endl;
+        return false;
+    }
+    mapping = (const unsigned char*)address;
+    mappingSize = (size_t)status.st_size;
+#else
+    std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+    if (!in || in.tellg() <= 0) {
+        std::cout << "Could not open " << fileName << std::endl;
+        return false;
+    }
+    fileData.resize((size_t)in.tellg());
+    in.seekg(0);
+    if (!in.read((char*)fileData.data(), fileData.size())) {
+        std::cout << "Could not read " << fileName << std::endl;
+        fileData.clear();
+        return false;
+    }
+    mapping = fileData.data();
+    mappingSize = fileData.size();
+#endif
+    return true;
+}
+
+void SceneFile::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    file.clear();
+    tiles.clear();
+    flags = 0;
+#if !defined(_WIN32)
+    if (mapping != nullptr) {
+        munmap((void*)mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    fileSize = 0;
+    fileData.clear();
+    fileData.shrink_to_fit();
+}
+
+const uint8_t* SceneFile::getMappedBlocks(const TileEntry& entry) {
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    return mapping + entry.offset;
+}
+
+bool SceneFile::readTile(const TileEntry& entry, 
+                         std::vector<Scene::Block>& blocks) {
+    size_t numBlocks = tileDimensions.x * tileDimensions.y * tileDimensions.z;
+    const unsigned char* source = getMappedBlocks(entry);
+    if (source == nullptr) {
+        compressed.resize(entry.size);
+        file.seekg(entry.offset);
+        if (!file.read((char*)compressed.data(), compressed.size())) {
+            file.clear();
+            return false;
+        }
+        if (flags & FLAG_RAW) {
+            packed.swap(compressed);
+        } else {
+            packed.clear();
+            if (lodepng::decompress(packed, compressed) != 0) {
+                return false;
+            }
+        }
+        if (packed.size() != numBlocks) {
+            return false;
+        }
+        source = packed.data();
+    }
+    blocks.resize(numBlocks);
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = unpackBlock(source[i]);
+    }
+    return true;
+}
+
+uint8_t SceneFile::packBlock(const Scene::Block& block) {
+    if (block.blockType == Scene::Block::BlockType::EMPTY) {
+        return 0;
+    }
+    return ((int)block.blockType + 1) | ((block.rotation & 3) << 4) 
+         | (block.flipped ? 1 << 6 : 0);
+}
+
+Scene::Block SceneFile::unpackBlock(uint8_t packed) {
+    Scene::Block block;
+    int type = (packed & 0xf) - 1;
+    if (type < 0 || type >= (int)Scene::Block::BlockType::EMPTY) {
+        return block;
+    }
+    block.blockType = (Scene::Block::BlockType)type;
+    block.rotation = (packed >> 4) & 3;
+    block.flipped = (packed >> 6) & 1;
+    return block;
+}
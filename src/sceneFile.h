@@ -0,0 +1,107 @@
+/*==============================================================================
+The MIT License (MIT)
+
+Copyright (c) 2014 Juuso Toikka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../lib/glm/gtc/type_ptr.hpp"
+
+#include "scene.h"
+
+// Native binary scene format. A file starts with a header (the magic 
+// "VXCS", the format version, the tile dimensions and the number of tiles),
+// followed by a directory with an entry per tile, followed by the tiles' 
+// payloads. A payload holds one byte per block, see packBlock, compressed
+// with zlib unless the file is raw. Every value is little-endian. Through 
+// the directory, any tile can be read without reading the others.
+class SceneFile {
+public:
+    static const uint32_t VERSION = 1;
+
+    static const uint32_t FLAG_RAW = 1; // Payloads are not compressed
+
+    typedef struct TileEntry {
+        glm::ivec3 location;
+        uint32_t numBlocks;
+        uint64_t offset; // Of the payload, from the start of the file
+        uint32_t size; // Of the payload as stored
+    } TileEntry;
+
+    ~SceneFile();
+
+    // Writes the tiles to a new file, replacing any file of the same name.
+    // Raw files are larger, but can be mapped.
+    static bool write(const std::string& fileName, glm::ivec3 tileDimensions,
+                      const std::vector<Scene::Tile*>& tiles, bool raw = false);
+
+    // Reads the header and the directory. The file stays open for readTile.
+    // A raw file can be mapped into memory instead, so that only the pages
+    // of the tiles read are ever loaded.
+    bool open(const std::string& fileName, bool map = false);
+
+    void close();
+
+    bool isMapped() { return mapping != nullptr; }
+
+    // Packed blocks of a tile in the mapping, or null if not mapped
+    const uint8_t* getMappedBlocks(const TileEntry& entry);
+
+    glm::ivec3 getTileDimensions() { return tileDimensions; }
+
+    const std::vector<TileEntry>& getTiles() { return tiles; }
+
+    // Blocks are in the order of Scene::Tile::blocks
+    bool readTile(const TileEntry& entry, std::vector<Scene::Block>& blocks);
+
+    // Type in the low four bits (0 for empty), then rotation, then flipped
+    static uint8_t packBlock(const Scene::Block& block);
+
+    static Scene::Block unpackBlock(uint8_t packed);
+
+private:
+    std::ifstream file;
+    glm::ivec3 tileDimensions;
+    uint32_t flags = 0;
+    uint64_t fileSize = 0; // Bounds the directory and the payloads
+    std::vector<TileEntry> tiles;
+
+    const unsigned char* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<unsigned char> fileData; // Stands in for a mapping on Windows
+
+    bool mapFile(const std::string& fileName);
+
+    bool readDirectory(const std::string& fileName, 
+                       const unsigned char* header, 
+                       const unsigned char* directory, size_t directorySize);
+
+    std::vector<unsigned char> compressed; // Kept between reads
+    std::vector<unsigned char> packed;
+};
+
+#endif
@@ -158,7 +158,7 @@ void State::buildGUI(glm::vec2 dimensions) {
 
     // Mode buttons ------------------------------------------------------------
 
-    gui->addButtonLinker(glm::vec2(120.0f, 40.0f), 
+    gui->addContainer(glm::vec2(120.0f, 190.0f), 
         "modeButtonContainer", "SideBar",
         glm::vec4(70.0f/255.0f, 70.0f/255.0f, 70.0f/255.0f, 1.0f), 
         glm::vec4(10.0f, 0.0f, 0.0f, 0.0f), glm::ivec4(1, 0, 0, 0), 
@@ -176,6 +176,61 @@ void State::buildGUI(glm::vec2 dimensions) {
                    glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
                    glm::ivec4(1, 0, 0, 0));
 
+    std::shared_ptr<EventInterface> eventOcclusion(new Event<void*>);
+    eventOcclusion->action = Action::TOGGLE_OCCLUSION_CULLING;
+    eventOcclusion->ids = {"renderer"};
+
+    gui->addButton(glm::vec2(100.0f, 20.0f), nullptr, L"Occlusion", "modeButtonContainer",
+                   eventOcclusion,
+                   glm::vec4(114.0f/255.0f, 114.0f/255.0f, 114.0f/255.0f, 1.0f), 
+                   glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),
+                   glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
+                   glm::ivec4(1, 0, 0, 0));
+
+    std::shared_ptr<EventInterface> eventSSAO(new Event<void*>);
+    eventSSAO->action = Action::TOGGLE_SSAO;
+    eventSSAO->ids = {"renderer"};
+
+    gui->addButton(glm::vec2(100.0f, 20.0f), nullptr, L"SSAO", "modeButtonContainer",
+                   eventSSAO,
+                   glm::vec4(114.0f/255.0f, 114.0f/255.0f, 114.0f/255.0f, 1.0f), 
+                   glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),
+                   glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
+                   glm::ivec4(1, 0, 0, 0));
+
+    std::shared_ptr<EventInterface> eventRadiosity(new Event<void*>);
+    eventRadiosity->action = Action::TOGGLE_RADIOSITY;
+    eventRadiosity->ids = {"renderer"};
+
+    gui->addButton(glm::vec2(100.0f, 20.0f), nullptr, L"Radiosity", "modeButtonContainer",
+                   eventRadiosity,
+                   glm::vec4(114.0f/255.0f, 114.0f/255.0f, 114.0f/255.0f, 1.0f), 
+                   glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),
+                   glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
+                   glm::ivec4(1, 0, 0, 0));
+
+    std::shared_ptr<EventInterface> eventInstanced(new Event<void*>);
+    eventInstanced->action = Action::TOGGLE_INSTANCED_BLOCKS;
+    eventInstanced->ids = {"renderer"};
+
+    gui->addButton(glm::vec2(100.0f, 20.0f), nullptr, L"Instancing", "modeButtonContainer",
+                   eventInstanced,
+                   glm::vec4(114.0f/255.0f, 114.0f/255.0f, 114.0f/255.0f, 1.0f), 
+                   glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),
+                   glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
+                   glm::ivec4(1, 0, 0, 0));
+
+    std::shared_ptr<EventInterface> eventPicking(new Event<void*>);
+    eventPicking->action = Action::TOGGLE_CPU_PICKING;
+    eventPicking->ids = {"renderer"};
+
+    gui->addButton(glm::vec2(100.0f, 20.0f), nullptr, L"CPU picking", "modeButtonContainer",
+                   eventPicking,
+                   glm::vec4(114.0f/255.0f, 114.0f/255.0f, 114.0f/255.0f, 1.0f), 
+                   glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),
+                   glm::vec4(10.0f, 1.0f, 0.0f, 1.0f),
+                   glm::ivec4(1, 0, 0, 0));
+
     // Blocks ------------------------------------------------------------------
 
     gui->addButtonLinker(glm::vec2(120.0f, 250.0f), 
@@ -352,8 +407,19 @@ void State::resizeWindow(int width, int height) {
     }
 }
 
-void State::save(std::wstring title) {
+void State::save(std::wstring title, bool raw) {
     std::wcout << L"Saving to: " << title << std::endl;
+    scene->save(std::string(title.begin(), title.end()), raw);
+}
+
+void State::load(std::wstring title) {
+    std::wcout << L"Loading from: " << title << std::endl;
+    scene->load(std::string(title.begin(), title.end()));
+}
+
+void State::open(std::wstring title) {
+    std::wcout << L"Opening: " << title << std::endl;
+    scene->open(std::string(title.begin(), title.end()));
 }
 
 void State::handleEvents() {
@@ -406,10 +472,40 @@ void State::runCommand() {
                 if (!(commandStream >> title)) {
                     title = L"untitled.tile";
                 }
-                save(title);
+                std::wstring format;
+                save(title, (commandStream >> format) && format == L"raw");
+            } else if (command == L"load" || command == L"open") {
+                std::wstring title;
+                if (!(commandStream >> title)) {
+                    title = L"untitled.tile";
+                }
+                if (command == L"load") {
+                    load(title);
+                } else {
+                    open(title);
+                }
             } else if (command == L"export") {
                 std::vector<Scene*> args = {scene};
                 eventManager->addEvent({"renderer"}, Action::EXPORT_TILE, args);
+            } else if (command == L"delete" || command == L"retype" 
+                    || command == L"rotate" || command == L"deselect") {
+                // Bulk edits of the blocks selected by shift- or control-
+                // dragging, retyped to the block picked in the side bar
+                Action action = Action::DELETE_SELECTION;
+                if (command == L"retype") {
+                    action = Action::RETYPE_SELECTION;
+                } else if (command == L"rotate") {
+                    action = Action::ROTATE_SELECTION;
+                } else if (command == L"deselect") {
+                    action = Action::CLEAR_SELECTION;
+                }
+                std::vector<void*> args;
+                eventManager->addEvent({"scene"}, action, args);
+            } else if (command == L"stats") {
+                renderer->printStats();
+                eventManager->printStats();
+            } else if (command == L"benchmark") {
+                renderer->benchmarkMeshing(scene);
             }
         }
         renderer->removeText(it->second->getText());
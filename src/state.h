@@ -84,7 +84,11 @@ private:
 
     void runCommand();
 
-    void save(std::wstring title);
+    void save(std::wstring title, bool raw = false);
+
+    void load(std::wstring title);
+
+    void open(std::wstring title); // Read-only, through a memory map
 
     void backspace();
 };